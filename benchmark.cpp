@@ -0,0 +1,291 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <cmath>
+
+Benchmark::Benchmark(int frameCount, int warmupFrames)
+    : frameCount(frameCount), warmupFrames(warmupFrames)
+{
+}
+
+// Render one frame, returns false once the window has been closed.
+bool renderFrame()
+{
+    if (!VK::headless)
+    {
+        if (glfwWindowShouldClose(VK::window))
+            return false;
+        glfwPollEvents();
+    }
+    VK::render();
+    return true;
+}
+
+void Benchmark::run()
+{
+    /*
+        Warm-up frames are not measured. The first frames pay for lazy driver work
+        (shader compilation, memory paging) that would skew the results.
+    */
+    for (int i = 0; i < warmupFrames; i++)
+    {
+        if (!renderFrame())
+            return;
+    }
+
+    frameTimes.reserve(frameCount);
+    acquireTimes.reserve(frameCount);
+    recordTimes.reserve(frameCount);
+    submitTimes.reserve(frameCount);
+    presentTimes.reserve(frameCount);
+
+    auto start = std::chrono::steady_clock::now();
+    auto frameStart = start;
+    for (int i = 0; i < frameCount; i++)
+    {
+        if (!renderFrame())
+            break;
+
+        // Frame time is measured between frames so event polling is included.
+        auto now = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(now - frameStart).count());
+        frameStart = now;
+
+        acquireTimes.push_back(VK::frameTimings.acquire);
+        recordTimes.push_back(VK::frameTimings.record);
+        submitTimes.push_back(VK::frameTimings.submit);
+        presentTimes.push_back(VK::frameTimings.present);
+
+        if (VK::gpuFrameStats.available)
+        {
+            if (VK::timestampsSupported)
+            {
+                gpuTimes.push_back(VK::gpuFrameStats.gpuTime);
+                latencyTimes.push_back(VK::gpuFrameStats.latency);
+            }
+            if (VK::pipelineStatisticsSupported)
+            {
+                vertexInvocations.push_back(static_cast<double>(VK::gpuFrameStats.vertexInvocations));
+                fragmentInvocations.push_back(static_cast<double>(VK::gpuFrameStats.fragmentInvocations));
+            }
+        }
+    }
+    elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Benchmark::runResizeStorm(int count)
+{
+    int baseWidth = VK::width;
+    int baseHeight = VK::height;
+
+    resizeTimes.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        // Alternate between the original size and a smaller one.
+        int width = (i % 2 == 0) ? baseWidth / 2 + 1 : baseWidth;
+        int height = (i % 2 == 0) ? baseHeight / 2 + 1 : baseHeight;
+
+        auto start = std::chrono::steady_clock::now();
+        if (VK::headless)
+        {
+            VK::width = width;
+            VK::height = height;
+        }
+        else
+        {
+            glfwSetWindowSize(VK::window, width, height);
+            glfwPollEvents();
+        }
+        VK::recreateSwapchain();
+        if (!renderFrame())
+            break;
+        resizeTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+std::vector<InstanceData> Benchmark::createInstanceGrid(uint32_t count)
+{
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float cell = 2.0f / side; // Normalized device coordinates span [-1, 1].
+
+    std::vector<InstanceData> instances(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t x = i % side;
+        uint32_t y = i / side;
+        instances[i].offset = glm::vec2(-1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f));
+        instances[i].scale = glm::vec2(cell * 0.8f); // The quad is 1 wide, leave a gap between instances.
+        uint32_t r = x * 255 / side, g = y * 255 / side, b = 255 - r;
+        instances[i].color = r | (g << 8) | (b << 16) | (255u << 24);
+    }
+    return instances;
+}
+
+// Linear interpolation between the closest ranks of sorted samples.
+double percentile(const std::vector<double>& sorted, double p)
+{
+    double rank = p * (sorted.size() - 1);
+    size_t lower = static_cast<size_t>(rank);
+    size_t upper = std::min(lower + 1, sorted.size() - 1);
+    return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+}
+
+SampleStats Benchmark::computeStats(std::vector<double> samples)
+{
+    SampleStats stats;
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    stats.p50 = percentile(samples, 0.50);
+    stats.p95 = percentile(samples, 0.95);
+    stats.p99 = percentile(samples, 0.99);
+    return stats;
+}
+
+void writeStats(std::ostream& out, const char* name, const SampleStats& stats)
+{
+    out << "  \"" << name << "\": { "
+        << "\"min\": " << stats.min << ", "
+        << "\"mean\": " << stats.mean << ", "
+        << "\"p50\": " << stats.p50 << ", "
+        << "\"p95\": " << stats.p95 << ", "
+        << "\"p99\": " << stats.p99 << ", "
+        << "\"max\": " << stats.max << " }";
+}
+
+// Writes value as a quoted JSON string. Driver-provided names may contain any character.
+void writeString(std::ostream& out, const char* value)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    out << '"';
+    for (const char* c = value; *c != '\0'; c++)
+    {
+        unsigned char ch = static_cast<unsigned char>(*c);
+        if (ch == '"' || ch == '\\')
+            out << '\\' << *c;
+        else if (ch == '\n')
+            out << "\\n";
+        else if (ch == '\r')
+            out << "\\r";
+        else if (ch == '\t')
+            out << "\\t";
+        else if (ch < 0x20)
+            out << "\\u00" << hexDigits[ch >> 4] << hexDigits[ch & 0xf];
+        else
+            out << *c;
+    }
+    out << '"';
+}
+
+void Benchmark::writeJson(std::ostream& out) const
+{
+    size_t frames = frameTimes.size();
+    double fps = elapsedSeconds > 0.0 ? frames / elapsedSeconds : 0.0;
+
+    out << "{\n";
+    out << "  \"device\": ";
+    writeString(out, VK::deviceCapabilities.properties.deviceName);
+    out << ",\n";
+    out << "  \"device_type\": \"" << getDeviceTypeName(VK::deviceCapabilities.properties.deviceType) << "\",\n";
+    out << "  \"headless\": " << (VK::headless ? "true" : "false") << ",\n";
+    out << "  \"width\": " << VK::swapchainExtent.width << ",\n";
+    out << "  \"height\": " << VK::swapchainExtent.height << ",\n";
+    out << "  \"warmup_frames\": " << warmupFrames << ",\n";
+    out << "  \"draw_calls\": " << VK::drawCallCount << ",\n";
+    out << "  \"instances\": " << VK::instanceCount << ",\n";
+    out << "  \"particles\": " << VK::particleCount << ",\n";
+    out << "  \"gpu_culling\": " << (VK::gpuCulling ? "true" : "false") << ",\n";
+    out << "  \"parallel_init\": " << (VK::parallelInit ? "true" : "false") << ",\n";
+    out << "  \"startup_ms\": " << VK::startupMilliseconds << ",\n";
+    out << "  \"startup\": [";
+    for (size_t i = 0; i < VK::startupTimings.size(); i++)
+    {
+        const TaskTiming& timing = VK::startupTimings[i];
+        out << (i ? ", " : "") << "{ \"name\": ";
+        writeString(out, timing.name.c_str());
+        out << ", \"start_ms\": " << timing.startMs
+            << ", \"duration_ms\": " << timing.durationMs << " }";
+    }
+    out << "],\n";
+    out << "  \"vertex_format\": \"" << getVertexFormatName(VK::activeVertexFormat) << "\",\n";
+    out << "  \"vertex_cache\": { "
+        << "\"acmr_before\": " << VK::meshCacheMissRatioBefore << ", "
+        << "\"acmr_after\": " << VK::meshCacheMissRatioAfter << " },\n";
+    out << "  \"present_mode\": \"" << (VK::headless ? "offscreen" : getPresentModeName(VK::presentMode)) << "\",\n";
+    out << "  \"swapchain_images\": " << VK::swapchainImages.size() << ",\n";
+    out << "  \"frames_in_flight\": " << VK::framesInFlight << ",\n";
+    out << "  \"low_latency\": " << (VK::lowLatency ? "true" : "false") << ",\n";
+    out << "  \"frame_sync\": \"" << (VK::timelineSemaphoresEnabled ? "timeline" : "fences") << "\",\n";
+    out << "  \"dedicated_transfer_queue\": " << (VK::dedicatedTransferQueue ? "true" : "false") << ",\n";
+    out << "  \"async_compute\": " << (VK::asyncCompute ? "true" : "false") << ",\n";
+    out << "  \"recording_threads\": " << VK::recordingThreads.getThreadCount() << ",\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"elapsed_s\": " << elapsedSeconds << ",\n";
+    out << "  \"fps\": " << fps << ",\n";
+    writeStats(out, "frame_ms", computeStats(frameTimes));
+    out << ",\n";
+    writeStats(out, "acquire_ms", computeStats(acquireTimes));
+    out << ",\n";
+    writeStats(out, "record_ms", computeStats(recordTimes));
+    out << ",\n";
+    writeStats(out, "submit_ms", computeStats(submitTimes));
+    out << ",\n";
+    writeStats(out, "present_ms", computeStats(presentTimes));
+    out << ",\n";
+    writeStats(out, "latency_ms", computeStats(latencyTimes));
+    out << ",\n";
+    out << "  \"gpu_timestamps\": " << (VK::timestampsSupported ? "true" : "false") << ",\n";
+    out << "  \"gpu_samples\": " << gpuTimes.size() << ",\n";
+    writeStats(out, "gpu_ms", computeStats(gpuTimes));
+    out << ",\n";
+    out << "  \"pipeline_statistics\": " << (VK::pipelineStatisticsSupported ? "true" : "false") << ",\n";
+    writeStats(out, "vertex_invocations", computeStats(vertexInvocations));
+    out << ",\n";
+    writeStats(out, "fragment_invocations", computeStats(fragmentInvocations));
+    out << ",\n";
+    out << "  \"resizes\": " << resizeTimes.size() << ",\n";
+    writeStats(out, "resize_ms", computeStats(resizeTimes));
+    out << ",\n";
+
+    AllocatorStats memory = VK::allocator.getStats();
+    out << "  \"memory\": { "
+        << "\"blocks\": " << memory.blockCount << ", "
+        << "\"allocations\": " << memory.allocationCount << ", "
+        << "\"dedicated_allocations\": " << memory.dedicatedAllocationCount << ", "
+        << "\"device_memory_allocations\": " << memory.deviceMemoryAllocations << ", "
+        << "\"block_bytes\": " << memory.blockBytes << ", "
+        << "\"used_bytes\": " << memory.usedBytes << ", "
+        << "\"dedicated_bytes\": " << memory.dedicatedBytes << " }";
+    out << ",\n";
+
+    PipelineLayoutStats layouts = VK::pipelineLayoutCache.getStats();
+    out << "  \"pipeline_layouts\": { "
+        << "\"pipeline_layouts\": " << layouts.pipelineLayoutCount << ", "
+        << "\"descriptor_set_layouts\": " << layouts.descriptorSetLayoutCount << ", "
+        << "\"requests\": " << layouts.requests << ", "
+        << "\"hits\": " << layouts.hits << " }";
+    out << ",\n";
+
+    RingBufferStats uniforms = VK::uniformRing.getStats();
+    out << "  \"uniform_ring\": { "
+        << "\"frame_capacity\": " << uniforms.frameCapacity << ", "
+        << "\"peak_frame_bytes\": " << uniforms.peakFrameBytes << ", "
+        << "\"allocations\": " << uniforms.allocations << ", "
+        << "\"overflows\": " << uniforms.overflows << " }";
+    out << ",\n";
+
+    RingBufferStats stream = VK::vertexStream.getStats();
+    out << "  \"vertex_stream\": { "
+        << "\"frame_capacity\": " << stream.frameCapacity << ", "
+        << "\"peak_frame_bytes\": " << stream.peakFrameBytes << ", "
+        << "\"allocations\": " << stream.allocations << ", "
+        << "\"overflows\": " << stream.overflows << ", "
+        << "\"flushes\": " << stream.flushes << " }";
+    out << "\n}\n";
+}
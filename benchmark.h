@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <ostream>
+
+#include "vulkan_example.h"
+
+// Summary of a series of samples.
+struct SampleStats
+{
+    double min = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+class Benchmark
+{
+public:
+    Benchmark(int frameCount, int warmupFrames);
+
+    // Render the warm-up frames, then the measured frames.
+    void run();
+    // Recreate the swapchain count times, alternating between two sizes.
+    void runResizeStorm(int count);
+    void writeJson(std::ostream& out) const;
+
+    static SampleStats computeStats(std::vector<double> samples);
+    // count small quads in a grid covering the screen, to measure instanced draw throughput.
+    static std::vector<InstanceData> createInstanceGrid(uint32_t count);
+
+private:
+    int frameCount;
+    int warmupFrames;
+    double elapsedSeconds = 0.0;
+
+    // Per-frame samples. (milliseconds)
+    std::vector<double> frameTimes;
+    std::vector<double> acquireTimes;
+    std::vector<double> recordTimes;
+    std::vector<double> submitTimes;
+    std::vector<double> presentTimes;
+    std::vector<double> latencyTimes; // Input sampling to GPU completion, read back with the timestamps.
+    std::vector<double> gpuTimes; // Read back from timestamp queries, a few frames late.
+
+    std::vector<double> resizeTimes; // Swapchain recreation plus the first frame after it.
+
+    // Per-frame pipeline statistics. (counts)
+    std::vector<double> vertexInvocations;
+    std::vector<double> fragmentInvocations;
+};
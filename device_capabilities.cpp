@@ -0,0 +1,97 @@
+#include "device_capabilities.h"
+
+#include <algorithm>
+
+DeviceCapabilities DeviceCapabilities::query(VkInstance instance, VkPhysicalDevice physicalDevice, bool queryFeatures2)
+{
+    DeviceCapabilities capabilities;
+    capabilities.physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceProperties(physicalDevice, &capabilities.properties);
+    vkGetPhysicalDeviceFeatures(physicalDevice, &capabilities.features);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &capabilities.memoryProperties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    capabilities.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, capabilities.queueFamilies.data());
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (const VkExtensionProperties& extension : extensions)
+        capabilities.extensions.push_back(extension.extensionName);
+
+    for (uint32_t i = 0; i < capabilities.memoryProperties.memoryHeapCount; i++)
+    {
+        const VkMemoryHeap& heap = capabilities.memoryProperties.memoryHeaps[i];
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            capabilities.deviceLocalMemory = std::max(capabilities.deviceLocalMemory, heap.size);
+    }
+
+    // Features of extensions are returned in structs chained to VkPhysicalDeviceFeatures2.
+    if (queryFeatures2 && capabilities.hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+    {
+        auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        if (getFeatures2 != nullptr)
+        {
+            VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+            timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+            VkPhysicalDeviceFeatures2KHR features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+            features.pNext = &timelineFeatures;
+            getFeatures2(physicalDevice, &features);
+            capabilities.timelineSemaphore = timelineFeatures.timelineSemaphore == VK_TRUE;
+        }
+    }
+    return capabilities;
+}
+
+bool DeviceCapabilities::hasExtension(const char* name) const
+{
+    return std::any_of(extensions.begin(), extensions.end(),
+        [&](const std::string& extension) { return extension == name; });
+}
+bool DeviceCapabilities::hasQueueFamily(VkQueueFlags required, VkQueueFlags excluded) const
+{
+    return std::any_of(queueFamilies.begin(), queueFamilies.end(), [&](const VkQueueFamilyProperties& family)
+        { return (family.queueFlags & required) == required && (family.queueFlags & excluded) == 0; });
+}
+
+uint64_t DeviceCapabilities::getScore() const
+{
+    uint64_t typeRank = 0;
+    switch (properties.deviceType)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+    default: break;
+    }
+
+    // Whole MiB, 40 bits are enough for a petabyte.
+    uint64_t memoryMiB = std::min<uint64_t>(deviceLocalMemory >> 20, (1ull << 40) - 1);
+
+    uint64_t featureCount = 0;
+    featureCount += timelineSemaphore;
+    featureCount += features.pipelineStatisticsQuery == VK_TRUE;
+    featureCount += hasQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    featureCount += hasQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+
+    // Type in the highest bits, then memory, then features, so each only breaks ties of the one before.
+    return (typeRank << 56) | (memoryMiB << 8) | featureCount;
+}
+
+const char* getDeviceTypeName(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+    default: return "other";
+    }
+}
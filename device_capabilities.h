@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/*
+    Snapshot of what a physical device offers: properties and limits, features, memory types
+    and heaps, queue families and extensions. None of it changes while the program runs,
+    so it is queried from the driver once per device and read from here afterwards.
+*/
+struct DeviceCapabilities
+{
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceFeatures features{};
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    std::vector<std::string> extensions;
+    bool timelineSemaphore = false; // VK_KHR_timeline_semaphore and its feature are supported.
+    VkDeviceSize deviceLocalMemory = 0; // Size of the largest device local heap.
+
+    // queryFeatures2: the instance has VK_KHR_get_physical_device_properties2, needed for extension features.
+    static DeviceCapabilities query(VkInstance instance, VkPhysicalDevice physicalDevice, bool queryFeatures2);
+
+    bool hasExtension(const char* name) const;
+    bool hasQueueFamily(VkQueueFlags required, VkQueueFlags excluded = 0) const;
+
+    /*
+        Ranks devices for selection, higher is better. In order of importance:
+        device type (discrete, integrated, virtual, CPU), device local memory,
+        then optional features the renderer uses.
+    */
+    uint64_t getScore() const;
+};
+
+const char* getDeviceTypeName(VkPhysicalDeviceType type);
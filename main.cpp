@@ -1,11 +1,121 @@
 #include "vulkan_example.h"
 
 #include <iostream>
+#include <fstream>
+#include <string>
 
-int main()
+#include "benchmark.h"
+
+int main(int argc, char* argv[])
 {
     try
     {
+        /*
+            Command line options:
+            --headless: Render without a window into offscreen images.
+            --device D: GPU to use, by index in the printed device list or part of its name. (default: highest ranked, or VK_EXAMPLE_DEVICE)
+            --width W, --height H: Size of the window or offscreen images.
+            --frames N: Number of frames to render in headless mode. (default 1)
+            --bench-frames N: Measure N frames and print the results as JSON.
+            --warmup M: Frames rendered before measuring starts. (default 10)
+            --bench-output FILE: Write the benchmark JSON to a file instead of stdout.
+            --resize-storm N: Benchmark N swapchain recreations after the measured frames.
+            --threads N: Worker threads recording command buffers. (default: one per hardware thread, 0: main thread only)
+            --draw-calls N: Draw the scene with N draw calls. (default 1)
+            --instances N: Draw N instanced quads in a grid, e.g. 1000000 to measure draw throughput.
+            --gpu-culling: Cull instances in a compute shader and draw them with indirect draws.
+            --particles N: Generate N particles on the CPU every frame and draw them from the streaming vertex buffer.
+            --serial-init: Run the startup steps one after another instead of in parallel.
+            --shader-dir DIR: Load .spv files from DIR instead of the shaders embedded in the executable.
+            --vertex-format F: float32, half or snorm16. (default snorm16, float32 if the mesh loses too much precision)
+            --present-mode M: immediate, mailbox, fifo or fifo-relaxed. (default mailbox, fifo if not supported)
+            --swapchain-images N: Images in the swapchain or offscreen images. (default: one more than the minimum)
+            --frames-in-flight N: Frames the CPU may record ahead of the GPU. (default 2)
+            --low-latency: Once an image is acquired, wait for the previous frame and poll input right before recording.
+            --fence-sync: Track frame completion with fences instead of a timeline semaphore.
+            --single-queue: Upload and cull on the graphics queue even if the GPU has dedicated transfer and compute queues.
+        */
+        int frames = 1;
+        int benchFrames = 0;
+        int warmupFrames = 10;
+        int resizeStorm = 0;
+        uint32_t instances = 0;
+        std::string benchOutput;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--headless")
+                VK::headless = true;
+            else if (arg == "--gpu-culling")
+                VK::gpuCulling = true;
+            else if (arg == "--serial-init")
+                VK::parallelInit = false;
+            else if (arg == "--low-latency")
+                VK::lowLatency = true;
+            else if (arg == "--fence-sync")
+                VK::useTimelineSemaphores = false;
+            else if (arg == "--single-queue")
+                VK::useDedicatedQueues = false;
+            else if (arg == "--device" && i + 1 < argc)
+                VK::deviceOverride = argv[++i];
+            else if (arg == "--width" && i + 1 < argc)
+                VK::width = std::stoi(argv[++i]);
+            else if (arg == "--height" && i + 1 < argc)
+                VK::height = std::stoi(argv[++i]);
+            else if (arg == "--frames" && i + 1 < argc)
+                frames = std::stoi(argv[++i]);
+            else if (arg == "--bench-frames" && i + 1 < argc)
+                benchFrames = std::stoi(argv[++i]);
+            else if (arg == "--warmup" && i + 1 < argc)
+                warmupFrames = std::stoi(argv[++i]);
+            else if (arg == "--bench-output" && i + 1 < argc)
+                benchOutput = argv[++i];
+            else if (arg == "--resize-storm" && i + 1 < argc)
+                resizeStorm = std::stoi(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc)
+                VK::recordingThreadCount = std::stoi(argv[++i]);
+            else if (arg == "--draw-calls" && i + 1 < argc)
+                VK::drawCallCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--instances" && i + 1 < argc)
+                instances = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--particles" && i + 1 < argc)
+                VK::particleCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--shader-dir" && i + 1 < argc)
+                VK::shaderDirectory = argv[++i];
+            else if (arg == "--vertex-format" && i + 1 < argc)
+            {
+                std::string format = argv[++i];
+                if (format == "float32")
+                    VK::vertexFormat = VertexFormat::Float32;
+                else if (format == "half")
+                    VK::vertexFormat = VertexFormat::Half;
+                else if (format == "snorm16")
+                    VK::vertexFormat = VertexFormat::Snorm16;
+                else
+                    throw std::runtime_error("Unknown vertex format: " + format);
+            }
+            else if (arg == "--present-mode" && i + 1 < argc)
+            {
+                std::string mode = argv[++i];
+                if (mode == "immediate")
+                    VK::requestedPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                else if (mode == "mailbox")
+                    VK::requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+                else if (mode == "fifo")
+                    VK::requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+                else if (mode == "fifo-relaxed")
+                    VK::requestedPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                else
+                    throw std::runtime_error("Unknown present mode: " + mode);
+            }
+            else if (arg == "--swapchain-images" && i + 1 < argc)
+                VK::requestedSwapchainImageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--frames-in-flight" && i + 1 < argc)
+                VK::framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else
+                throw std::runtime_error("Unknown argument: " + arg);
+        }
+
         // AppInfo: Application configuration for creating Vulkan instance. (technically optional)
         // Create Vuklan instance, list available extensions and apply validation layers(debug mode only).
         VkApplicationInfo appInfo{};
@@ -17,10 +127,40 @@ int main()
         appInfo.apiVersion = VK_API_VERSION_1_0;
         VK::init(appInfo);
 
-        while (!glfwWindowShouldClose(VK::window))
+        if (instances > 0)
+            VK::setInstances(Benchmark::createInstanceGrid(instances));
+
+        if (benchFrames > 0 || resizeStorm > 0)
+        {
+            Benchmark benchmark(benchFrames, warmupFrames);
+            benchmark.run();
+            if (resizeStorm > 0)
+                benchmark.runResizeStorm(resizeStorm);
+
+            if (benchOutput.empty())
+            {
+                benchmark.writeJson(std::cout);
+            }
+            else
+            {
+                std::ofstream file(benchOutput);
+                if (!file.is_open())
+                    throw std::runtime_error("Failed to open file: " + benchOutput);
+                benchmark.writeJson(file);
+            }
+        }
+        else if (VK::headless)
+        {
+            for (int i = 0; i < frames; i++)
+                VK::render();
+        }
+        else
         {
-            glfwPollEvents();
-            VK::render();
+            while (!glfwWindowShouldClose(VK::window))
+            {
+                glfwPollEvents();
+                VK::render();
+            }
         }
 
         VK::cleanup();
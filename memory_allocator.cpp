@@ -0,0 +1,298 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void MemoryAllocator::init(const DeviceCapabilities& device, VkDevice logicalDevice)
+{
+    this->device = logicalDevice;
+
+    // Memory properties never change for a device, they come from the capability snapshot.
+    memoryProperties = device.memoryProperties;
+    bufferImageGranularity = device.properties.limits.bufferImageGranularity;
+    nonCoherentAtomSize = device.properties.limits.nonCoherentAtomSize;
+
+    pools.clear();
+    pools.resize(memoryProperties.memoryTypeCount * 2);
+}
+void MemoryAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Freeing memory also unmaps it.
+    for (auto& pool : pools)
+    {
+        for (auto& block : pool.blocks)
+            vkFreeMemory(device, block->memory, nullptr);
+    }
+    pools.clear();
+}
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        if (typeFilter & (1 << i) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+
+    throw std::runtime_error("Failed to find suitable memory type.");
+}
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const
+{
+    // Small heaps (e.g. the 256MB host visible part of VRAM) get smaller blocks.
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    return heapSize / 8 < DEFAULT_BLOCK_SIZE ? heapSize / 8 : DEFAULT_BLOCK_SIZE;
+}
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate device memory.");
+    deviceMemoryAllocations++;
+
+    // Host visible memory is mapped once and stays mapped. (a memory object can only be mapped once)
+    *mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+            throw std::runtime_error("Failed to map device memory.");
+    }
+
+    return memory;
+}
+void MemoryAllocator::addFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    block.freeByOffset[offset] = size;
+    block.freeBySize.insert({ size, offset });
+}
+void MemoryAllocator::removeFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    block.freeByOffset.erase(offset);
+    auto range = block.freeBySize.equal_range(size);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == offset)
+        {
+            block.freeBySize.erase(it);
+            break;
+        }
+    }
+}
+bool MemoryAllocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation)
+{
+    /*
+        Best fit: start at the smallest free range that is large enough.
+        A range can still be too small once its offset is aligned, then try the next one.
+    */
+    for (auto it = block.freeBySize.lower_bound(size); it != block.freeBySize.end(); ++it)
+    {
+        VkDeviceSize rangeSize = it->first;
+        VkDeviceSize rangeOffset = it->second;
+        VkDeviceSize alignedOffset = (rangeOffset + alignment - 1) / alignment * alignment;
+        if (alignedOffset + size > rangeOffset + rangeSize)
+            continue;
+
+        // Split the range, the padding in front and the rest behind the allocation stay free.
+        removeFreeRange(block, rangeOffset, rangeSize);
+        if (alignedOffset > rangeOffset)
+            addFreeRange(block, rangeOffset, alignedOffset - rangeOffset);
+        if (alignedOffset + size < rangeOffset + rangeSize)
+            addFreeRange(block, alignedOffset + size, rangeOffset + rangeSize - (alignedOffset + size));
+
+        block.allocationCount++;
+        block.usedBytes += size;
+
+        allocation.memory = block.memory;
+        allocation.offset = alignedOffset;
+        allocation.size = size;
+        allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + alignedOffset : nullptr;
+        allocation.block = &block;
+        return true;
+    }
+    return false;
+}
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Allocation allocation;
+    allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+    /*
+        Flushes of non-coherent memory cover whole nonCoherentAtomSize units. Allocations in such
+        memory start and end on those units, so flushing one never touches its neighbours.
+    */
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = requirements.alignment;
+    if (!isCoherent(allocation.memoryType))
+    {
+        size = (size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+        alignment = std::max(alignment, nonCoherentAtomSize);
+    }
+    allocation.size = size;
+
+    // Large resources would waste most of a block, they get their own allocation.
+    VkDeviceSize blockSize = getBlockSize(allocation.memoryType);
+    if (size > blockSize / 2)
+    {
+        allocation.memory = allocateDeviceMemory(size, allocation.memoryType, &allocation.mapped);
+        dedicatedAllocationCount++;
+        dedicatedBytes += size;
+        return allocation;
+    }
+
+    /*
+        bufferImageGranularity: linear resources (buffers) and optimal tiling images
+        placed next to each other in the same memory must be this many bytes apart.
+        Keeping them in separate blocks means neighbours never need extra padding.
+    */
+    bool separate = bufferImageGranularity > 1 && !linear;
+    uint32_t poolIndex = allocation.memoryType * 2 + (separate ? 1 : 0);
+    Pool& pool = pools[poolIndex];
+
+    for (auto& block : pool.blocks)
+    {
+        if (allocateFromBlock(*block, size, alignment, allocation))
+            return allocation;
+    }
+
+    // No space left in the existing blocks.
+    auto block = std::make_unique<MemoryBlock>();
+    block->memory = allocateDeviceMemory(blockSize, allocation.memoryType, &block->mapped);
+    block->size = blockSize;
+    block->pool = poolIndex;
+    addFreeRange(*block, 0, blockSize);
+    pool.blocks.push_back(std::move(block));
+
+    if (!allocateFromBlock(*pool.blocks.back(), size, alignment, allocation))
+        throw std::runtime_error("Failed to sub-allocate device memory.");
+    return allocation;
+}
+bool MemoryAllocator::isCoherent(uint32_t memoryType) const
+{
+    VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+    return !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) || (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+void MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+    if (size == 0 || isCoherent(allocation.memoryType))
+        return;
+
+    // Widened to whole atoms, which stay inside the allocation since it starts and ends on atoms.
+    VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+    VkDeviceSize end = (allocation.offset + offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end - begin;
+    if (vkFlushMappedMemoryRanges(device, 1, &range) != VK_SUCCESS)
+        throw std::runtime_error("Failed to flush mapped memory.");
+}
+Allocation MemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    Allocation allocation = allocate(memRequirements, properties, true);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    return allocation;
+}
+Allocation MemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    Allocation allocation = allocate(memRequirements, properties, false);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    return allocation;
+}
+void MemoryAllocator::free(Allocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (allocation.block == nullptr)
+    {
+        vkFreeMemory(device, allocation.memory, nullptr);
+        dedicatedAllocationCount--;
+        dedicatedBytes -= allocation.size;
+        allocation = Allocation{};
+        return;
+    }
+
+    MemoryBlock& block = *allocation.block;
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize size = allocation.size;
+
+    // Merge with the free ranges directly behind and in front of the allocation.
+    auto next = block.freeByOffset.find(offset + size);
+    if (next != block.freeByOffset.end())
+    {
+        VkDeviceSize nextOffset = next->first;
+        VkDeviceSize nextSize = next->second;
+        removeFreeRange(block, nextOffset, nextSize);
+        size += nextSize;
+    }
+    auto previous = block.freeByOffset.lower_bound(offset);
+    if (previous != block.freeByOffset.begin())
+    {
+        --previous;
+        VkDeviceSize previousOffset = previous->first;
+        VkDeviceSize previousSize = previous->second;
+        if (previousOffset + previousSize == offset)
+        {
+            removeFreeRange(block, previousOffset, previousSize);
+            offset = previousOffset;
+            size += previousSize;
+        }
+    }
+    addFreeRange(block, offset, size);
+
+    block.allocationCount--;
+    block.usedBytes -= allocation.size;
+
+    // Give empty blocks back to the driver, but keep the last one of a pool for reuse.
+    Pool& pool = pools[block.pool];
+    if (block.allocationCount == 0 && pool.blocks.size() > 1)
+    {
+        for (auto it = pool.blocks.begin(); it != pool.blocks.end(); ++it)
+        {
+            if (it->get() == &block)
+            {
+                vkFreeMemory(device, block.memory, nullptr);
+                pool.blocks.erase(it);
+                break;
+            }
+        }
+    }
+
+    allocation = Allocation{};
+}
+AllocatorStats MemoryAllocator::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    AllocatorStats stats;
+    for (const auto& pool : pools)
+    {
+        for (const auto& block : pool.blocks)
+        {
+            stats.blockCount++;
+            stats.allocationCount += block->allocationCount;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->usedBytes;
+        }
+    }
+    stats.dedicatedAllocationCount = dedicatedAllocationCount;
+    stats.allocationCount += dedicatedAllocationCount;
+    stats.dedicatedBytes = dedicatedBytes;
+    stats.deviceMemoryAllocations = deviceMemoryAllocations;
+    return stats;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "device_capabilities.h"
+
+struct MemoryBlock;
+
+// A range of device memory handed out by the MemoryAllocator.
+struct Allocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // Host visible memory stays mapped, points at offset.
+    uint32_t memoryType = 0;
+    MemoryBlock* block = nullptr; // nullptr for dedicated allocations.
+};
+
+struct AllocatorStats
+{
+    uint32_t blockCount = 0;
+    uint32_t dedicatedAllocationCount = 0;
+    uint32_t allocationCount = 0; // Live allocations, sub-allocated and dedicated.
+    uint64_t deviceMemoryAllocations = 0; // Total vkAllocateMemory calls so far.
+    VkDeviceSize blockBytes = 0; // Memory reserved by blocks.
+    VkDeviceSize usedBytes = 0; // Memory used by sub-allocations inside blocks.
+    VkDeviceSize dedicatedBytes = 0;
+};
+
+// A block of device memory that is sub-allocated.
+struct MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    uint32_t pool = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize usedBytes = 0;
+
+    // Free ranges, indexed by offset (to merge neighbours) and by size (for best fit).
+    std::map<VkDeviceSize, VkDeviceSize> freeByOffset;
+    std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;
+};
+
+/*
+    Device memory allocator.
+    Drivers only allow a limited number of allocations (maxMemoryAllocationCount, can be as
+    low as 4096) and vkAllocateMemory is slow, so memory is allocated in large blocks per
+    memory type and resources get a range inside a block. Large resources get their own
+    dedicated allocation.
+*/
+class MemoryAllocator
+{
+public:
+    static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    void init(const DeviceCapabilities& device, VkDevice logicalDevice);
+    void destroy();
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+    // linear: buffers and linear images. Optimal tiling images must pass false.
+    Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+    Allocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+    Allocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties);
+    void free(Allocation& allocation);
+
+    /*
+        Host visible memory without VK_MEMORY_PROPERTY_HOST_COHERENT_BIT: CPU writes only reach the
+        GPU once flushed. flush() makes [offset, offset + size) of an allocation visible, relative
+        to the allocation. Does nothing for coherent memory.
+    */
+    bool isCoherent(uint32_t memoryType) const;
+    void flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+    AllocatorStats getStats() const;
+
+private:
+    struct Pool
+    {
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize bufferImageGranularity = 1;
+    VkDeviceSize nonCoherentAtomSize = 1;
+    std::vector<Pool> pools; // Two per memory type: linear and optimal resources.
+    uint32_t dedicatedAllocationCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+    uint64_t deviceMemoryAllocations = 0;
+    mutable std::mutex mutex;
+
+    VkDeviceSize getBlockSize(uint32_t memoryType) const;
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+    bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+    void addFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+    void removeFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+};
@@ -0,0 +1,347 @@
+#include "mesh.h"
+
+#include <unordered_map>
+#include <deque>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+// Vertices are compared bit by bit, vertices that only look equal (0.0 and -0.0) are kept apart.
+struct VertexHash
+{
+    size_t operator()(const Vertex& vertex) const
+    {
+        const float values[] = { vertex.pos.x, vertex.pos.y, vertex.color.x, vertex.color.y, vertex.color.z };
+        size_t hash = 0;
+        for (float value : values)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            hash ^= std::hash<uint32_t>()(bits) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        }
+        return hash;
+    }
+};
+struct VertexEqual
+{
+    bool operator()(const Vertex& a, const Vertex& b) const
+    {
+        return std::memcmp(&a.pos, &b.pos, sizeof(a.pos)) == 0
+            && std::memcmp(&a.color, &b.color, sizeof(a.color)) == 0;
+    }
+};
+
+Mesh Mesh::fromTriangleList(const std::vector<Vertex>& triangleVertices)
+{
+    Mesh mesh;
+    mesh.indices.reserve(triangleVertices.size());
+
+    std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+    uniqueVertices.reserve(triangleVertices.size());
+
+    for (const Vertex& vertex : triangleVertices)
+    {
+        auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(mesh.vertices.size()));
+        if (inserted.second)
+            mesh.vertices.push_back(vertex);
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+void Mesh::optimizeVertexCache(uint32_t cacheSize)
+{
+    size_t vertexCount = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles using each vertex, as offsets into one array.
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+        adjacencyOffsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd; // Recently used vertices, to continue from when there is no candidate.
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0; // Scans for any vertex with triangles left once the dead-end stack is empty.
+    int64_t fanning = 0;
+
+    while (fanning >= 0)
+    {
+        uint32_t vertex = static_cast<uint32_t>(fanning);
+        candidates.clear();
+
+        // Emit all remaining triangles around the fanning vertex.
+        for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+        {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                uint32_t v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Next fanning vertex: the candidate that is still in the cache the longest after its triangles are emitted.
+        fanning = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        if (fanning < 0)
+        {
+            // Dead end, continue from a recently used vertex or any vertex with triangles left.
+            while (!deadEnd.empty() && fanning < 0)
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0)
+                    fanning = v;
+            }
+            while (cursor < vertexCount && fanning < 0)
+            {
+                if (liveTriangles[cursor] > 0)
+                    fanning = static_cast<int64_t>(cursor);
+                cursor++;
+            }
+        }
+    }
+
+    indices = std::move(output);
+}
+
+void Mesh::optimizeVertexFetch()
+{
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    // Vertices no triangle refers to are dropped.
+    vertices = std::move(ordered);
+}
+
+const char* getVertexFormatName(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::Half: return "half";
+    case VertexFormat::Snorm16: return "snorm16";
+    default: return "float32";
+    }
+}
+
+// IEEE 754 binary16 conversion, rounding to nearest even.
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) // Infinity or NaN.
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31) // Too large, becomes infinity.
+        return static_cast<uint16_t>(sign | 0x7c00);
+    if (exponent <= 0) // Denormal or zero.
+    {
+        if (exponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++; // May carry into the exponent, which still gives the correct result.
+    return static_cast<uint16_t>(half);
+}
+static float halfToFloat(uint16_t half)
+{
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0)
+    {
+        // Zero or denormal: mantissa * 2^-24.
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+static uint8_t unormToByte(float value)
+{
+    return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+QuantizedVertices Mesh::quantize(VertexFormat format) const
+{
+    QuantizedVertices result;
+    result.vertices.resize(vertices.size());
+    if (vertices.empty())
+        return result;
+
+    if (format == VertexFormat::Snorm16)
+    {
+        // Normalize positions to [-1, 1] within the bounds of the mesh, per axis.
+        glm::vec2 minimum = vertices[0].pos, maximum = vertices[0].pos;
+        for (const Vertex& vertex : vertices)
+        {
+            minimum = glm::vec2(std::min(minimum.x, vertex.pos.x), std::min(minimum.y, vertex.pos.y));
+            maximum = glm::vec2(std::max(maximum.x, vertex.pos.x), std::max(maximum.y, vertex.pos.y));
+        }
+        result.positionOffset = (minimum + maximum) * 0.5f;
+        result.positionScale = (maximum - minimum) * 0.5f;
+        // Flat meshes: any scale works for an axis without extent.
+        if (result.positionScale.x == 0.0f) result.positionScale.x = 1.0f;
+        if (result.positionScale.y == 0.0f) result.positionScale.y = 1.0f;
+    }
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        CompactVertex& compact = result.vertices[i];
+        glm::vec2 decoded;
+
+        for (int axis = 0; axis < 2; axis++)
+        {
+            if (format == VertexFormat::Half)
+            {
+                compact.pos[axis] = floatToHalf(vertex.pos[axis]);
+                decoded[axis] = halfToFloat(compact.pos[axis]);
+            }
+            else
+            {
+                // Decoding maps -32768 and -32767 both to -1.0, only [-32767, 32767] is used.
+                float normalized = (vertex.pos[axis] - result.positionOffset[axis]) / result.positionScale[axis];
+                int16_t encoded = static_cast<int16_t>(std::lround(std::min(std::max(normalized, -1.0f), 1.0f) * 32767.0f));
+                compact.pos[axis] = static_cast<uint16_t>(encoded);
+                decoded[axis] = encoded / 32767.0f * result.positionScale[axis] + result.positionOffset[axis];
+            }
+        }
+
+        compact.color = unormToByte(vertex.color.x) | (unormToByte(vertex.color.y) << 8)
+            | (unormToByte(vertex.color.z) << 16) | (255u << 24);
+
+        glm::vec2 error = decoded - vertex.pos;
+        result.maxPositionError = std::max(result.maxPositionError, std::sqrt(error.x * error.x + error.y * error.y));
+    }
+    return result;
+}
+
+VkIndexType Mesh::getIndexType() const
+{
+    // Primitive restart is not used, so 0xFFFF is a valid index too.
+    return vertices.size() <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+std::vector<char> Mesh::getIndexData() const
+{
+    std::vector<char> data;
+    if (getIndexType() == VK_INDEX_TYPE_UINT16)
+    {
+        data.resize(indices.size() * sizeof(uint16_t));
+        uint16_t* shortIndices = reinterpret_cast<uint16_t*>(data.data());
+        for (size_t i = 0; i < indices.size(); i++)
+            shortIndices[i] = static_cast<uint16_t>(indices[i]);
+    }
+    else
+    {
+        data.resize(indices.size() * sizeof(uint32_t));
+        std::memcpy(data.data(), indices.data(), data.size());
+    }
+    return data;
+}
+
+double Mesh::averageCacheMissRatio(const std::vector<uint32_t>& indices, uint32_t cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.0;
+
+    std::deque<uint32_t> cache;
+    size_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        bool hit = false;
+        for (uint32_t cached : cache)
+        {
+            if (cached == index)
+            {
+                hit = true;
+                break;
+            }
+        }
+        if (!hit)
+        {
+            misses++;
+            cache.push_back(index);
+            if (cache.size() > cacheSize)
+                cache.pop_front();
+        }
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
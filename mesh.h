@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vulkan_example.h"
+
+#include <vector>
+
+/*
+    Quantized vertex, read by the same shader inputs as Vertex:
+    the vertex input stage converts both formats to floats, and the vertex shader
+    maps normalized positions back into the mesh bounds with positionScale and positionOffset.
+*/
+struct CompactVertex
+{
+    uint16_t pos[2]; // Half floats or signed normalized integers, see VertexFormat.
+    uint32_t color; // RGBA with 8 bits per channel, red in the lowest byte. Alpha is ignored.
+};
+// A vec3 shader input may read a four component format, the fourth component is dropped.
+VERTEX_ATTRIBUTES(CompactVertex,
+    VERTEX_ATTRIBUTE_FORMAT(CompactVertex, pos, VK_FORMAT_R16G16_SNORM),
+    VERTEX_ATTRIBUTE_FORMAT(CompactVertex, color, VK_FORMAT_R8G8B8A8_UNORM));
+VERTEX_ATTRIBUTE_SET(HalfVertexAttributes,
+    VERTEX_ATTRIBUTE_FORMAT(CompactVertex, pos, VK_FORMAT_R16G16_SFLOAT),
+    VERTEX_ATTRIBUTE_FORMAT(CompactVertex, color, VK_FORMAT_R8G8B8A8_UNORM));
+
+using Snorm16VertexInputLayout = VertexLayout<PerVertex<CompactVertex>, PerInstance<InstanceData>>;
+using HalfVertexInputLayout = VertexLayout<PerVertex<CompactVertex, HalfVertexAttributes>, PerInstance<InstanceData>>;
+struct QuantizedVertices
+{
+    std::vector<CompactVertex> vertices;
+    // Decoded position = encoded position * positionScale + positionOffset.
+    glm::vec2 positionScale = glm::vec2(1.0f);
+    glm::vec2 positionOffset = glm::vec2(0.0f);
+    float maxPositionError = 0.0f; // Largest distance between a decoded and an original position.
+};
+
+/*
+    Indexed triangle mesh.
+    Meshes are authored as plain triangle lists where shared corners are repeated,
+    fromTriangleList() merges identical vertices and the optimize functions reorder
+    triangles and vertices so the GPU transforms and fetches every vertex as few times as possible.
+*/
+struct Mesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // Deduplicates the vertices of a triangle list with a hash map.
+    static Mesh fromTriangleList(const std::vector<Vertex>& triangleVertices);
+
+    /*
+        Reorders triangles for the post-transform vertex cache (Tipsify, Sander et al. 2007):
+        triangles sharing vertices that are still in the cache are emitted next to each other.
+    */
+    void optimizeVertexCache(uint32_t cacheSize = 16);
+    // Reorders vertices in the order they are first used, so vertex fetches walk memory linearly.
+    void optimizeVertexFetch();
+
+    /*
+        Encodes the vertices in a compact format (Half or Snorm16) and measures the precision loss,
+        the caller decides whether maxPositionError is acceptable for the mesh.
+    */
+    QuantizedVertices quantize(VertexFormat format) const;
+
+    // 16-bit indices halve the index buffer size, they are used whenever every index fits.
+    VkIndexType getIndexType() const;
+    // Indices packed in the format of getIndexType(), ready for upload.
+    std::vector<char> getIndexData() const;
+
+    // Average number of vertex shader invocations per triangle with a FIFO cache of cacheSize entries. (0.5 - 3)
+    static double averageCacheMissRatio(const std::vector<uint32_t>& indices, uint32_t cacheSize = 16);
+};
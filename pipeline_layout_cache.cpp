@@ -0,0 +1,168 @@
+#include "pipeline_layout_cache.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void PipelineLayoutCache::init(VkDevice logicalDevice)
+{
+    this->logicalDevice = logicalDevice;
+}
+void PipelineLayoutCache::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : pipelineLayouts)
+        vkDestroyPipelineLayout(logicalDevice, entry.second.layout, nullptr);
+    for (auto& entry : descriptorSetLayouts)
+        vkDestroyDescriptorSetLayout(logicalDevice, entry.second, nullptr);
+    pipelineLayouts.clear();
+    descriptorSetLayouts.clear();
+    stats = PipelineLayoutStats();
+}
+
+size_t PipelineLayoutCache::KeyHash::operator()(const std::vector<uint32_t>& key) const
+{
+    // FNV-1a over the words.
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t word : key)
+    {
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+PipelineLayoutStats PipelineLayoutCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreateDescriptorSetLayout(bindings);
+}
+VkDescriptorSetLayout PipelineLayoutCache::findOrCreateDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::vector<uint32_t> key;
+    key.reserve(bindings.size() * 4);
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+        if (binding.pImmutableSamplers != nullptr)
+            throw std::runtime_error("Immutable samplers are not supported by the pipeline layout cache.");
+        key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags });
+    }
+
+    auto it = descriptorSetLayouts.find(key);
+    if (it != descriptorSetLayouts.end())
+        return it->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create descriptor set layout.");
+    descriptorSetLayouts.emplace(std::move(key), layout);
+    stats.descriptorSetLayoutCount++;
+    return layout;
+}
+
+const CachedPipelineLayout& PipelineLayoutCache::getPipelineLayout(const std::vector<ShaderReflection>& stages)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.requests++;
+
+    // Bindings used by several stages become one binding visible to all of them.
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+    for (const ShaderReflection& stage : stages)
+    {
+        for (const ShaderDescriptorBinding& descriptor : stage.descriptorBindings)
+        {
+            if (sets.size() <= descriptor.set)
+                sets.resize(descriptor.set + 1);
+            std::vector<VkDescriptorSetLayoutBinding>& set = sets[descriptor.set];
+
+            auto existing = std::find_if(set.begin(), set.end(),
+                [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == descriptor.binding; });
+            if (existing == set.end())
+            {
+                VkDescriptorSetLayoutBinding binding{};
+                binding.binding = descriptor.binding;
+                binding.descriptorType = descriptor.descriptorType;
+                binding.descriptorCount = descriptor.descriptorCount;
+                binding.stageFlags = stage.stage;
+                set.push_back(binding);
+            }
+            else if (existing->descriptorType != descriptor.descriptorType || existing->descriptorCount != descriptor.descriptorCount)
+            {
+                throw std::runtime_error("Shader stages disagree on set " + std::to_string(descriptor.set)
+                    + " binding " + std::to_string(descriptor.binding) + ".");
+            }
+            else
+            {
+                existing->stageFlags |= stage.stage;
+            }
+        }
+
+        // A stage may only appear in one push constant range.
+        if (stage.pushConstantSize > 0)
+        {
+            auto existing = std::find_if(pushConstantRanges.begin(), pushConstantRanges.end(),
+                [&](const VkPushConstantRange& r) { return (r.stageFlags & stage.stage) != 0; });
+            if (existing != pushConstantRanges.end())
+                throw std::runtime_error("Two shaders of the same stage in one pipeline layout.");
+
+            VkPushConstantRange range{};
+            range.stageFlags = stage.stage;
+            range.offset = stage.pushConstantOffset;
+            range.size = stage.pushConstantSize;
+            pushConstantRanges.push_back(range);
+        }
+    }
+
+    // Key: set count, then per set its binding count and bindings, then the push constant ranges.
+    std::vector<uint32_t> key;
+    key.push_back(static_cast<uint32_t>(sets.size()));
+    for (std::vector<VkDescriptorSetLayoutBinding>& set : sets)
+    {
+        std::sort(set.begin(), set.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+        key.push_back(static_cast<uint32_t>(set.size()));
+        for (const VkDescriptorSetLayoutBinding& binding : set)
+            key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags });
+    }
+    std::sort(pushConstantRanges.begin(), pushConstantRanges.end(),
+        [](const VkPushConstantRange& a, const VkPushConstantRange& b) { return a.stageFlags < b.stageFlags; });
+    for (const VkPushConstantRange& range : pushConstantRanges)
+        key.insert(key.end(), { range.stageFlags, range.offset, range.size });
+
+    auto it = pipelineLayouts.find(key);
+    if (it != pipelineLayouts.end())
+    {
+        stats.hits++;
+        return it->second;
+    }
+
+    // Sets without bindings in between still need a (empty) layout.
+    CachedPipelineLayout cached;
+    cached.pushConstantRanges = pushConstantRanges;
+    for (const std::vector<VkDescriptorSetLayoutBinding>& set : sets)
+        cached.setLayouts.push_back(findOrCreateDescriptorSetLayout(set));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(cached.setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = cached.setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &cached.layout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline layout.");
+
+    stats.pipelineLayoutCount++;
+    return pipelineLayouts.emplace(std::move(key), std::move(cached)).first->second;
+}
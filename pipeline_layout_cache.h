@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include "spirv_reflection.h"
+
+struct PipelineLayoutStats
+{
+    uint32_t descriptorSetLayoutCount = 0;
+    uint32_t pipelineLayoutCount = 0;
+    uint64_t requests = 0; // Calls to getPipelineLayout().
+    uint64_t hits = 0; // Requests answered with an existing layout.
+};
+
+// A pipeline layout and the descriptor set layouts it was created with, owned by the cache.
+struct CachedPipelineLayout
+{
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> setLayouts; // Indexed by set number.
+    std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+/*
+    Creates pipeline layouts from the reflected interface of their shaders.
+    Layouts are keyed by their contents, pipelines whose shaders bind the same resources
+    and push constants share one VkPipelineLayout (and pipelines with compatible layouts
+    can keep descriptor sets bound across pipeline switches). The cache owns every object
+    it creates, they live until destroy(). Pipelines may be created on several threads at once.
+*/
+class PipelineLayoutCache
+{
+public:
+    void init(VkDevice logicalDevice);
+    void destroy();
+
+    // Merges the bindings and push constants of all stages. The returned object stays valid until destroy().
+    const CachedPipelineLayout& getPipelineLayout(const std::vector<ShaderReflection>& stages);
+    VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+    PipelineLayoutStats getStats() const;
+
+private:
+    // Layout descriptions flattened into words, the key of the hash maps.
+    struct KeyHash
+    {
+        size_t operator()(const std::vector<uint32_t>& key) const;
+    };
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    mutable std::mutex mutex;
+    std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, KeyHash> descriptorSetLayouts;
+    std::unordered_map<std::vector<uint32_t>, CachedPipelineLayout, KeyHash> pipelineLayouts;
+    PipelineLayoutStats stats;
+
+    VkDescriptorSetLayout findOrCreateDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+};
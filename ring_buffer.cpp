@@ -0,0 +1,99 @@
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void RingBuffer::create(VkDevice logicalDevice, MemoryAllocator& allocator, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkDeviceSize frameCapacity, uint32_t frameCount, VkDeviceSize alignment)
+{
+    this->logicalDevice = logicalDevice;
+    this->allocator = &allocator;
+    this->alignment = std::max<VkDeviceSize>(alignment, 1);
+    // Every frame's part starts aligned.
+    this->frameCapacity = alignUp(frameCapacity, this->alignment);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = this->frameCapacity * frameCount;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create ring buffer.");
+
+    // Coherent memory: writes become visible to the GPU at submit, flush() has nothing to do.
+    memory = allocator.allocateForBuffer(buffer, properties);
+    if (memory.mapped == nullptr)
+        throw std::runtime_error("Ring buffer memory is not host visible.");
+
+    // Stats are kept, they add up over every buffer the ring had.
+    frame = 0;
+    frameOffset = 0;
+    flushedOffset = 0;
+}
+void RingBuffer::destroy()
+{
+    if (buffer == VK_NULL_HANDLE)
+        return;
+    vkDestroyBuffer(logicalDevice, buffer, nullptr);
+    allocator->free(memory);
+    buffer = VK_NULL_HANDLE;
+}
+
+void RingBuffer::release(VkBuffer& releasedBuffer, Allocation& releasedMemory)
+{
+    releasedBuffer = buffer;
+    releasedMemory = memory;
+    buffer = VK_NULL_HANDLE;
+    memory = Allocation();
+}
+
+void RingBuffer::beginFrame(uint32_t frame)
+{
+    peakFrameBytes = std::max<VkDeviceSize>(peakFrameBytes, frameOffset);
+    this->frame = frame;
+    frameOffset = 0;
+    flushedOffset = 0;
+}
+bool RingBuffer::allocate(VkDeviceSize size, RingAllocation& allocation)
+{
+    // Sizes are rounded up, so every offset handed out stays aligned.
+    VkDeviceSize offset = frameOffset.fetch_add(alignUp(size, alignment));
+    if (offset + size > frameCapacity)
+    {
+        overflows++;
+        return false;
+    }
+    allocations++;
+    allocation.offset = frameCapacity * frame + offset;
+    allocation.data = static_cast<char*>(memory.mapped) + allocation.offset;
+    return true;
+}
+
+void RingBuffer::flush()
+{
+    // Overflowed requests moved frameOffset past the end without writing anything there.
+    VkDeviceSize end = std::min<VkDeviceSize>(frameOffset, frameCapacity);
+    if (end <= flushedOffset)
+        return;
+    if (!allocator->isCoherent(memory.memoryType))
+    {
+        allocator->flush(memory, frameCapacity * frame + flushedOffset, end - flushedOffset);
+        flushes++;
+    }
+    flushedOffset = end;
+}
+
+VkDeviceSize RingBuffer::alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+RingBufferStats RingBuffer::getStats() const
+{
+    RingBufferStats stats;
+    stats.frameCapacity = frameCapacity;
+    stats.allocations = allocations;
+    stats.overflows = overflows;
+    stats.peakFrameBytes = std::max<VkDeviceSize>(peakFrameBytes, frameOffset);
+    stats.flushes = flushes;
+    return stats;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+#include "memory_allocator.h"
+
+struct RingBufferStats
+{
+    VkDeviceSize frameCapacity = 0; // Bytes available to each frame.
+    uint64_t allocations = 0; // Successful allocate() calls so far.
+    uint64_t overflows = 0; // allocate() calls that didn't fit into their frame's part.
+    VkDeviceSize peakFrameBytes = 0; // Most bytes a frame asked for, including requests that overflowed.
+    uint64_t flushes = 0; // vkFlushMappedMemoryRanges calls, only made for non-coherent memory.
+};
+
+// A range of the ring buffer, valid until the same frame in flight begins again.
+struct RingAllocation
+{
+    VkDeviceSize offset = 0; // From the start of the buffer, for dynamic offsets and vkCmdBindVertexBuffers.
+    void* data = nullptr; // Mapped pointer to offset.
+};
+
+/*
+    Host visible buffer for data that is written by the CPU every frame.
+    The buffer is split into one part per frame in flight and stays mapped, so writing
+    a frame's data is a memcpy into the part of the current frame. Once the frame slot
+    comes around again its previous frame has completed, the part is reused from the start.
+    Allocation is a single atomic add, any number of threads may allocate at once.
+    Requests that don't fit fail and are counted, the ring never grows by itself.
+    In non-coherent memory the data only reaches the GPU once flushed: allocations are
+    handed out back to back, so flush() covers everything written since the last flush
+    with one range, once all threads are done writing.
+*/
+class RingBuffer
+{
+public:
+    /*
+        properties: must include VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT.
+        alignment: of every allocation, e.g. minUniformBufferOffsetAlignment for dynamic uniform buffers.
+    */
+    void create(VkDevice logicalDevice, MemoryAllocator& allocator, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkDeviceSize frameCapacity, uint32_t frameCount, VkDeviceSize alignment);
+    void destroy();
+    // Hands the buffer and its memory over to the caller, e.g. to destroy them once frames in flight are done with them.
+    void release(VkBuffer& releasedBuffer, Allocation& releasedMemory);
+
+    // Starts allocating from the part of frame, whose previous frame must have completed.
+    void beginFrame(uint32_t frame);
+    // Returns false if size doesn't fit into the rest of the frame's part. Thread safe.
+    bool allocate(VkDeviceSize size, RingAllocation& allocation);
+    // Makes the current frame's writes visible to the GPU, call before submitting them. Not thread safe.
+    void flush();
+
+    VkBuffer getBuffer() const { return buffer; }
+    VkDeviceSize getAlignment() const { return alignment; }
+    RingBufferStats getStats() const;
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment);
+
+private:
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceSize frameCapacity = 0;
+    VkDeviceSize alignment = 1;
+    uint32_t frame = 0;
+    std::atomic<VkDeviceSize> frameOffset{ 0 }; // Bytes handed out in the current frame, may pass frameCapacity.
+    VkDeviceSize flushedOffset = 0; // End of the current frame's flushed bytes.
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> overflows{ 0 };
+    VkDeviceSize peakFrameBytes = 0;
+    uint64_t flushes = 0;
+};
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+Compiles the GLSL shaders to SPIR-V and embeds the SPIR-V in embedded_shaders.h,
+which the executable loads its shaders from.
+
+    python shader/compile_shaders.py
+
+glslc is taken from PATH or from the Vulkan SDK ($VULKAN_SDK). Without glslc the
+.spv files already in this directory are embedded as they are.
+"""
+import os
+import shutil
+import struct
+import subprocess
+import sys
+
+SHADER_DIR = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = os.path.join(SHADER_DIR, 'embedded_shaders.h')
+
+# GLSL source, SPIR-V file, array name in embedded_shaders.h.
+SHADERS = [
+    ('shader.vert', 'vert.spv', 'vert'),
+    ('shader.frag', 'frag.spv', 'frag'),
+    ('cull.comp', 'cull.spv', 'cull'),
+]
+
+
+def find_glslc():
+    glslc = shutil.which('glslc')
+    if glslc:
+        return glslc
+    sdk = os.environ.get('VULKAN_SDK')
+    if sdk:
+        for directory in ('bin', 'Bin', 'Bin32'):
+            for name in ('glslc', 'glslc.exe'):
+                path = os.path.join(sdk, directory, name)
+                if os.path.isfile(path):
+                    return path
+    return None
+
+
+def compile_shaders(glslc):
+    for source, spirv, _ in SHADERS:
+        subprocess.check_call([glslc, os.path.join(SHADER_DIR, source), '-o', os.path.join(SHADER_DIR, spirv)])
+
+
+def embed_shaders():
+    lines = [
+        '// Generated by shader/compile_shaders.py from the SPIR-V files in shader/, do not edit.',
+        '#pragma once',
+        '',
+        '#include <cstdint>',
+        '',
+        'namespace EmbeddedShaders',
+        '{',
+    ]
+    for _, spirv, name in SHADERS:
+        with open(os.path.join(SHADER_DIR, spirv), 'rb') as file:
+            data = file.read()
+        if len(data) % 4 != 0:
+            raise SystemExit('%s is not SPIR-V: size is not a multiple of 4' % spirv)
+        words = struct.unpack('<%dI' % (len(data) // 4), data)
+        if not words or words[0] != 0x07230203:
+            raise SystemExit('%s is not SPIR-V: wrong magic number' % spirv)
+
+        lines.append('    // %s' % spirv)
+        lines.append('    constexpr uint32_t %s[] = {' % name)
+        for i in range(0, len(words), 8):
+            lines.append('        ' + ', '.join('0x%08x' % word for word in words[i:i + 8]) + ',')
+        lines.append('    };')
+    lines.append('}')
+
+    with open(OUTPUT, 'w', newline='\n') as file:
+        file.write('\n'.join(lines) + '\n')
+
+
+def main():
+    glslc = find_glslc()
+    if glslc:
+        compile_shaders(glslc)
+    else:
+        print('glslc not found, embedding the existing SPIR-V files.', file=sys.stderr)
+    embed_shaders()
+
+
+if __name__ == '__main__':
+    main()
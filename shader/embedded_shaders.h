@@ -0,0 +1,201 @@
+// Generated by shader/compile_shaders.py from the SPIR-V files in shader/, do not edit.
+#pragma once
+
+#include <cstdint>
+
+namespace EmbeddedShaders
+{
+    // vert.spv
+    constexpr uint32_t vert[] = {
+        0x07230203, 0x00010000, 0x000d0008, 0x00000045, 0x00000000, 0x00020011, 0x00000001, 0x0006000b,
+        0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e, 0x00000000, 0x0003000e, 0x00000000, 0x00000001,
+        0x000c000f, 0x00000000, 0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00000005,
+        0x00000006, 0x00000007, 0x00000008, 0x00000009, 0x00030003, 0x00000002, 0x000001c2, 0x00040005,
+        0x00000002, 0x6e69616d, 0x00000000, 0x00060005, 0x0000000a, 0x505f6c67, 0x65567265, 0x78657472,
+        0x00000000, 0x00060006, 0x0000000a, 0x00000000, 0x505f6c67, 0x7469736f, 0x006e6f69, 0x00070006,
+        0x0000000a, 0x00000001, 0x505f6c67, 0x746e696f, 0x657a6953, 0x00000000, 0x00070006, 0x0000000a,
+        0x00000002, 0x435f6c67, 0x4470696c, 0x61747369, 0x0065636e, 0x00070006, 0x0000000a, 0x00000003,
+        0x435f6c67, 0x446c6c75, 0x61747369, 0x0065636e, 0x00030005, 0x00000003, 0x00000000, 0x00050005,
+        0x00000004, 0x6f506e69, 0x69746973, 0x00006e6f, 0x00040005, 0x00000008, 0x6f436e69, 0x00726f6c,
+        0x00060005, 0x00000006, 0x74736e69, 0x65636e61, 0x7366664f, 0x00007465, 0x00060005, 0x00000005,
+        0x74736e69, 0x65636e61, 0x6c616353, 0x00000065, 0x00060005, 0x00000009, 0x74736e69, 0x65636e61,
+        0x6f6c6f43, 0x00000072, 0x00050005, 0x00000007, 0x67617266, 0x6f6c6f43, 0x00000072, 0x00060005,
+        0x0000000b, 0x74726556, 0x65447865, 0x65646f63, 0x00000000, 0x00070006, 0x0000000b, 0x00000000,
+        0x69736f70, 0x6e6f6974, 0x6c616353, 0x00000065, 0x00070006, 0x0000000b, 0x00000001, 0x69736f70,
+        0x6e6f6974, 0x7366664f, 0x00007465, 0x00040005, 0x0000000c, 0x6f636564, 0x00006564, 0x00060005,
+        0x0000000d, 0x6d617246, 0x696e5565, 0x6d726f66, 0x00000073, 0x00070006, 0x0000000d, 0x00000000,
+        0x77656976, 0x6a6f7250, 0x69746365, 0x00006e6f, 0x00040005, 0x0000000e, 0x6d617266, 0x00000065,
+        0x00060005, 0x0000000f, 0x656a624f, 0x6e557463, 0x726f6669, 0x0000736d, 0x00050006, 0x0000000f,
+        0x00000000, 0x65646f6d, 0x0000006c, 0x00040005, 0x00000010, 0x656a626f, 0x00007463, 0x00050048,
+        0x0000000a, 0x00000000, 0x0000000b, 0x00000000, 0x00050048, 0x0000000a, 0x00000001, 0x0000000b,
+        0x00000001, 0x00050048, 0x0000000a, 0x00000002, 0x0000000b, 0x00000003, 0x00050048, 0x0000000a,
+        0x00000003, 0x0000000b, 0x00000004, 0x00030047, 0x0000000a, 0x00000002, 0x00040047, 0x00000004,
+        0x0000001e, 0x00000000, 0x00040047, 0x00000008, 0x0000001e, 0x00000001, 0x00040047, 0x00000006,
+        0x0000001e, 0x00000002, 0x00040047, 0x00000005, 0x0000001e, 0x00000003, 0x00040047, 0x00000009,
+        0x0000001e, 0x00000004, 0x00040047, 0x00000007, 0x0000001e, 0x00000000, 0x00050048, 0x0000000b,
+        0x00000000, 0x00000023, 0x00000000, 0x00050048, 0x0000000b, 0x00000001, 0x00000023, 0x00000008,
+        0x00030047, 0x0000000b, 0x00000002, 0x00040048, 0x0000000d, 0x00000000, 0x00000005, 0x00050048,
+        0x0000000d, 0x00000000, 0x00000023, 0x00000000, 0x00050048, 0x0000000d, 0x00000000, 0x00000007,
+        0x00000010, 0x00030047, 0x0000000d, 0x00000002, 0x00040047, 0x0000000e, 0x00000022, 0x00000000,
+        0x00040047, 0x0000000e, 0x00000021, 0x00000000, 0x00040048, 0x0000000f, 0x00000000, 0x00000005,
+        0x00050048, 0x0000000f, 0x00000000, 0x00000023, 0x00000000, 0x00050048, 0x0000000f, 0x00000000,
+        0x00000007, 0x00000010, 0x00030047, 0x0000000f, 0x00000002, 0x00040047, 0x00000010, 0x00000022,
+        0x00000000, 0x00040047, 0x00000010, 0x00000021, 0x00000001, 0x00020013, 0x00000011, 0x00030021,
+        0x00000012, 0x00000011, 0x00030016, 0x00000013, 0x00000020, 0x00040017, 0x00000014, 0x00000013,
+        0x00000004, 0x00040015, 0x00000015, 0x00000020, 0x00000000, 0x0004002b, 0x00000015, 0x00000016,
+        0x00000001, 0x0004001c, 0x00000017, 0x00000013, 0x00000016, 0x0006001e, 0x0000000a, 0x00000014,
+        0x00000013, 0x00000017, 0x00000017, 0x00040020, 0x00000018, 0x00000003, 0x0000000a, 0x0004003b,
+        0x00000018, 0x00000003, 0x00000003, 0x00040015, 0x00000019, 0x00000020, 0x00000001, 0x0004002b,
+        0x00000019, 0x0000001a, 0x00000000, 0x00040017, 0x0000001b, 0x00000013, 0x00000002, 0x00040020,
+        0x0000001c, 0x00000001, 0x0000001b, 0x0004003b, 0x0000001c, 0x00000004, 0x00000001, 0x0004003b,
+        0x0000001c, 0x00000005, 0x00000001, 0x0004003b, 0x0000001c, 0x00000006, 0x00000001, 0x0004002b,
+        0x00000013, 0x0000001d, 0x00000000, 0x0004002b, 0x00000013, 0x0000001e, 0x3f800000, 0x00040020,
+        0x0000001f, 0x00000003, 0x00000014, 0x00040017, 0x00000020, 0x00000013, 0x00000003, 0x00040020,
+        0x00000021, 0x00000003, 0x00000020, 0x0004003b, 0x00000021, 0x00000007, 0x00000003, 0x00040020,
+        0x00000022, 0x00000001, 0x00000020, 0x0004003b, 0x00000022, 0x00000008, 0x00000001, 0x00040020,
+        0x00000023, 0x00000001, 0x00000014, 0x0004003b, 0x00000023, 0x00000009, 0x00000001, 0x0004002b,
+        0x00000019, 0x00000024, 0x00000001, 0x0004001e, 0x0000000b, 0x0000001b, 0x0000001b, 0x00040020,
+        0x00000025, 0x00000009, 0x0000000b, 0x0004003b, 0x00000025, 0x0000000c, 0x00000009, 0x00040020,
+        0x00000026, 0x00000009, 0x0000001b, 0x00040018, 0x00000027, 0x00000014, 0x00000004, 0x0003001e,
+        0x0000000d, 0x00000027, 0x00040020, 0x00000028, 0x00000002, 0x0000000d, 0x0004003b, 0x00000028,
+        0x0000000e, 0x00000002, 0x0003001e, 0x0000000f, 0x00000027, 0x00040020, 0x00000029, 0x00000002,
+        0x0000000f, 0x0004003b, 0x00000029, 0x00000010, 0x00000002, 0x00040020, 0x0000002a, 0x00000002,
+        0x00000027, 0x00050036, 0x00000011, 0x00000002, 0x00000000, 0x00000012, 0x000200f8, 0x0000002b,
+        0x0004003d, 0x0000001b, 0x0000002c, 0x00000004, 0x00050041, 0x00000026, 0x0000002d, 0x0000000c,
+        0x0000001a, 0x0004003d, 0x0000001b, 0x0000002e, 0x0000002d, 0x00050041, 0x00000026, 0x0000002f,
+        0x0000000c, 0x00000024, 0x0004003d, 0x0000001b, 0x00000030, 0x0000002f, 0x00050085, 0x0000001b,
+        0x00000031, 0x0000002c, 0x0000002e, 0x00050081, 0x0000001b, 0x00000032, 0x00000031, 0x00000030,
+        0x0004003d, 0x0000001b, 0x00000033, 0x00000005, 0x00050085, 0x0000001b, 0x00000034, 0x00000032,
+        0x00000033, 0x0004003d, 0x0000001b, 0x00000035, 0x00000006, 0x00050081, 0x0000001b, 0x00000036,
+        0x00000034, 0x00000035, 0x00050051, 0x00000013, 0x00000037, 0x00000036, 0x00000000, 0x00050051,
+        0x00000013, 0x00000038, 0x00000036, 0x00000001, 0x00070050, 0x00000014, 0x00000039, 0x00000037,
+        0x00000038, 0x0000001d, 0x0000001e, 0x00050041, 0x0000002a, 0x0000003a, 0x00000010, 0x0000001a,
+        0x0004003d, 0x00000027, 0x0000003b, 0x0000003a, 0x00050091, 0x00000014, 0x0000003c, 0x0000003b,
+        0x00000039, 0x00050041, 0x0000002a, 0x0000003d, 0x0000000e, 0x0000001a, 0x0004003d, 0x00000027,
+        0x0000003e, 0x0000003d, 0x00050091, 0x00000014, 0x0000003f, 0x0000003e, 0x0000003c, 0x00050041,
+        0x0000001f, 0x00000040, 0x00000003, 0x0000001a, 0x0003003e, 0x00000040, 0x0000003f, 0x0004003d,
+        0x00000020, 0x00000041, 0x00000008, 0x0004003d, 0x00000014, 0x00000042, 0x00000009, 0x0008004f,
+        0x00000020, 0x00000043, 0x00000042, 0x00000042, 0x00000000, 0x00000001, 0x00000002, 0x00050085,
+        0x00000020, 0x00000044, 0x00000041, 0x00000043, 0x0003003e, 0x00000007, 0x00000044, 0x000100fd,
+        0x00010038,
+    };
+    // frag.spv
+    constexpr uint32_t frag[] = {
+        0x07230203, 0x00010000, 0x000d0008, 0x00000013, 0x00000000, 0x00020011, 0x00000001, 0x0006000b,
+        0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e, 0x00000000, 0x0003000e, 0x00000000, 0x00000001,
+        0x0007000f, 0x00000004, 0x00000004, 0x6e69616d, 0x00000000, 0x00000009, 0x0000000c, 0x00030010,
+        0x00000004, 0x00000007, 0x00030003, 0x00000002, 0x000001c2, 0x00090004, 0x415f4c47, 0x735f4252,
+        0x72617065, 0x5f657461, 0x64616873, 0x6f5f7265, 0x63656a62, 0x00007374, 0x000a0004, 0x475f4c47,
+        0x4c474f4f, 0x70635f45, 0x74735f70, 0x5f656c79, 0x656e696c, 0x7269645f, 0x69746365, 0x00006576,
+        0x00080004, 0x475f4c47, 0x4c474f4f, 0x6e695f45, 0x64756c63, 0x69645f65, 0x74636572, 0x00657669,
+        0x00040005, 0x00000004, 0x6e69616d, 0x00000000, 0x00050005, 0x00000009, 0x4374756f, 0x726f6c6f,
+        0x00000000, 0x00050005, 0x0000000c, 0x67617266, 0x6f6c6f43, 0x00000072, 0x00040047, 0x00000009,
+        0x0000001e, 0x00000000, 0x00040047, 0x0000000c, 0x0000001e, 0x00000000, 0x00020013, 0x00000002,
+        0x00030021, 0x00000003, 0x00000002, 0x00030016, 0x00000006, 0x00000020, 0x00040017, 0x00000007,
+        0x00000006, 0x00000004, 0x00040020, 0x00000008, 0x00000003, 0x00000007, 0x0004003b, 0x00000008,
+        0x00000009, 0x00000003, 0x00040017, 0x0000000a, 0x00000006, 0x00000003, 0x00040020, 0x0000000b,
+        0x00000001, 0x0000000a, 0x0004003b, 0x0000000b, 0x0000000c, 0x00000001, 0x0004002b, 0x00000006,
+        0x0000000e, 0x3f800000, 0x00050036, 0x00000002, 0x00000004, 0x00000000, 0x00000003, 0x000200f8,
+        0x00000005, 0x0004003d, 0x0000000a, 0x0000000d, 0x0000000c, 0x00050051, 0x00000006, 0x0000000f,
+        0x0000000d, 0x00000000, 0x00050051, 0x00000006, 0x00000010, 0x0000000d, 0x00000001, 0x00050051,
+        0x00000006, 0x00000011, 0x0000000d, 0x00000002, 0x00070050, 0x00000007, 0x00000012, 0x0000000f,
+        0x00000010, 0x00000011, 0x0000000e, 0x0003003e, 0x00000009, 0x00000012, 0x000100fd, 0x00010038,
+    };
+    // cull.spv
+    constexpr uint32_t cull[] = {
+        0x07230203, 0x00010000, 0x000d0008, 0x0000006a, 0x00000000, 0x00020011, 0x00000001, 0x0006000b,
+        0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e, 0x00000000, 0x0003000e, 0x00000000, 0x00000001,
+        0x0006000f, 0x00000005, 0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00060010, 0x00000002,
+        0x00000011, 0x00000040, 0x00000001, 0x00000001, 0x00030003, 0x00000002, 0x000001c2, 0x00040005,
+        0x00000002, 0x6e69616d, 0x00000000, 0x00080005, 0x00000003, 0x475f6c67, 0x61626f6c, 0x766e496c,
+        0x7461636f, 0x496e6f69, 0x00000044, 0x00040005, 0x00000004, 0x61726150, 0x0000736d, 0x00050006,
+        0x00000004, 0x00000000, 0x73757266, 0x006d7574, 0x00070006, 0x00000004, 0x00000001, 0x74736e69,
+        0x65636e61, 0x6e756f43, 0x00000074, 0x00060006, 0x00000004, 0x00000002, 0x6873656d, 0x69646152,
+        0x00007375, 0x00040005, 0x00000005, 0x61726170, 0x0000736d, 0x00050005, 0x00000006, 0x74736e49,
+        0x65636e61, 0x00000073, 0x00060006, 0x00000006, 0x00000000, 0x74736e69, 0x65636e61, 0x00000073,
+        0x00030005, 0x00000007, 0x00000000, 0x00070005, 0x00000008, 0x69736956, 0x49656c62, 0x6174736e,
+        0x7365636e, 0x00000000, 0x00080006, 0x00000008, 0x00000000, 0x69736976, 0x49656c62, 0x6174736e,
+        0x7365636e, 0x00000000, 0x00030005, 0x00000009, 0x00000000, 0x00050005, 0x0000000a, 0x77617244,
+        0x6d6d6f43, 0x00646e61, 0x00060006, 0x0000000a, 0x00000000, 0x65646e69, 0x756f4378, 0x0000746e,
+        0x00070006, 0x0000000a, 0x00000001, 0x74736e69, 0x65636e61, 0x6e756f43, 0x00000074, 0x00060006,
+        0x0000000a, 0x00000002, 0x73726966, 0x646e4974, 0x00007865, 0x00070006, 0x0000000a, 0x00000003,
+        0x74726576, 0x664f7865, 0x74657366, 0x00000000, 0x00070006, 0x0000000a, 0x00000004, 0x73726966,
+        0x736e4974, 0x636e6174, 0x00000065, 0x00040005, 0x0000000b, 0x77617264, 0x00000000, 0x00040047,
+        0x00000003, 0x0000000b, 0x0000001c, 0x00050048, 0x00000004, 0x00000000, 0x00000023, 0x00000000,
+        0x00050048, 0x00000004, 0x00000001, 0x00000023, 0x00000010, 0x00050048, 0x00000004, 0x00000002,
+        0x00000023, 0x00000014, 0x00030047, 0x00000004, 0x00000002, 0x00040047, 0x0000000c, 0x00000006,
+        0x00000004, 0x00040048, 0x00000006, 0x00000000, 0x00000018, 0x00050048, 0x00000006, 0x00000000,
+        0x00000023, 0x00000000, 0x00030047, 0x00000006, 0x00000003, 0x00040047, 0x00000007, 0x00000022,
+        0x00000000, 0x00040047, 0x00000007, 0x00000021, 0x00000000, 0x00040048, 0x00000008, 0x00000000,
+        0x00000019, 0x00050048, 0x00000008, 0x00000000, 0x00000023, 0x00000000, 0x00030047, 0x00000008,
+        0x00000003, 0x00040047, 0x00000009, 0x00000022, 0x00000000, 0x00040047, 0x00000009, 0x00000021,
+        0x00000001, 0x00050048, 0x0000000a, 0x00000000, 0x00000023, 0x00000000, 0x00050048, 0x0000000a,
+        0x00000001, 0x00000023, 0x00000004, 0x00050048, 0x0000000a, 0x00000002, 0x00000023, 0x00000008,
+        0x00050048, 0x0000000a, 0x00000003, 0x00000023, 0x0000000c, 0x00050048, 0x0000000a, 0x00000004,
+        0x00000023, 0x00000010, 0x00030047, 0x0000000a, 0x00000003, 0x00040047, 0x0000000b, 0x00000022,
+        0x00000000, 0x00040047, 0x0000000b, 0x00000021, 0x00000002, 0x00020013, 0x0000000d, 0x00030021,
+        0x0000000e, 0x0000000d, 0x00020014, 0x0000000f, 0x00040015, 0x00000010, 0x00000020, 0x00000000,
+        0x00040015, 0x00000011, 0x00000020, 0x00000001, 0x00030016, 0x00000012, 0x00000020, 0x00040017,
+        0x00000013, 0x00000010, 0x00000003, 0x00040017, 0x00000014, 0x00000012, 0x00000004, 0x00040020,
+        0x00000015, 0x00000001, 0x00000013, 0x0004003b, 0x00000015, 0x00000003, 0x00000001, 0x00040020,
+        0x00000016, 0x00000001, 0x00000010, 0x0004002b, 0x00000010, 0x00000017, 0x00000000, 0x0004002b,
+        0x00000010, 0x00000018, 0x00000001, 0x0004002b, 0x00000010, 0x00000019, 0x00000002, 0x0004002b,
+        0x00000010, 0x0000001a, 0x00000003, 0x0004002b, 0x00000010, 0x0000001b, 0x00000004, 0x0004002b,
+        0x00000010, 0x0000001c, 0x00000005, 0x0004002b, 0x00000011, 0x0000001d, 0x00000000, 0x0004002b,
+        0x00000011, 0x0000001e, 0x00000001, 0x0004002b, 0x00000011, 0x0000001f, 0x00000002, 0x0005001e,
+        0x00000004, 0x00000014, 0x00000010, 0x00000012, 0x00040020, 0x00000020, 0x00000009, 0x00000004,
+        0x0004003b, 0x00000020, 0x00000005, 0x00000009, 0x00040020, 0x00000021, 0x00000009, 0x00000014,
+        0x00040020, 0x00000022, 0x00000009, 0x00000010, 0x00040020, 0x00000023, 0x00000009, 0x00000012,
+        0x0003001d, 0x0000000c, 0x00000010, 0x0003001e, 0x00000006, 0x0000000c, 0x00040020, 0x00000024,
+        0x00000002, 0x00000006, 0x0004003b, 0x00000024, 0x00000007, 0x00000002, 0x0003001e, 0x00000008,
+        0x0000000c, 0x00040020, 0x00000025, 0x00000002, 0x00000008, 0x0004003b, 0x00000025, 0x00000009,
+        0x00000002, 0x0007001e, 0x0000000a, 0x00000010, 0x00000010, 0x00000010, 0x00000011, 0x00000010,
+        0x00040020, 0x00000026, 0x00000002, 0x0000000a, 0x0004003b, 0x00000026, 0x0000000b, 0x00000002,
+        0x00040020, 0x00000027, 0x00000002, 0x00000010, 0x00050036, 0x0000000d, 0x00000002, 0x00000000,
+        0x0000000e, 0x000200f8, 0x00000028, 0x00050041, 0x00000016, 0x00000029, 0x00000003, 0x00000017,
+        0x0004003d, 0x00000010, 0x0000002a, 0x00000029, 0x00050041, 0x00000022, 0x0000002b, 0x00000005,
+        0x0000001e, 0x0004003d, 0x00000010, 0x0000002c, 0x0000002b, 0x000500b0, 0x0000000f, 0x0000002d,
+        0x0000002a, 0x0000002c, 0x000300f7, 0x0000002e, 0x00000000, 0x000400fa, 0x0000002d, 0x0000002f,
+        0x0000002e, 0x000200f8, 0x0000002f, 0x00050084, 0x00000010, 0x00000030, 0x0000002a, 0x0000001c,
+        0x00050080, 0x00000010, 0x00000031, 0x00000030, 0x00000017, 0x00050080, 0x00000010, 0x00000032,
+        0x00000030, 0x00000018, 0x00050080, 0x00000010, 0x00000033, 0x00000030, 0x00000019, 0x00050080,
+        0x00000010, 0x00000034, 0x00000030, 0x0000001a, 0x00050080, 0x00000010, 0x00000035, 0x00000030,
+        0x0000001b, 0x00060041, 0x00000027, 0x00000036, 0x00000007, 0x0000001d, 0x00000031, 0x00060041,
+        0x00000027, 0x00000037, 0x00000007, 0x0000001d, 0x00000032, 0x00060041, 0x00000027, 0x00000038,
+        0x00000007, 0x0000001d, 0x00000033, 0x00060041, 0x00000027, 0x00000039, 0x00000007, 0x0000001d,
+        0x00000034, 0x00060041, 0x00000027, 0x0000003a, 0x00000007, 0x0000001d, 0x00000035, 0x0004003d,
+        0x00000010, 0x0000003b, 0x00000036, 0x0004003d, 0x00000010, 0x0000003c, 0x00000037, 0x0004003d,
+        0x00000010, 0x0000003d, 0x00000038, 0x0004003d, 0x00000010, 0x0000003e, 0x00000039, 0x0004003d,
+        0x00000010, 0x0000003f, 0x0000003a, 0x0004007c, 0x00000012, 0x00000040, 0x0000003b, 0x0004007c,
+        0x00000012, 0x00000041, 0x0000003c, 0x0004007c, 0x00000012, 0x00000042, 0x0000003d, 0x0004007c,
+        0x00000012, 0x00000043, 0x0000003e, 0x0006000c, 0x00000012, 0x00000044, 0x00000001, 0x00000004,
+        0x00000042, 0x0006000c, 0x00000012, 0x00000045, 0x00000001, 0x00000004, 0x00000043, 0x0007000c,
+        0x00000012, 0x00000046, 0x00000001, 0x00000028, 0x00000044, 0x00000045, 0x00050041, 0x00000023,
+        0x00000047, 0x00000005, 0x0000001f, 0x0004003d, 0x00000012, 0x00000048, 0x00000047, 0x00050085,
+        0x00000012, 0x00000049, 0x00000046, 0x00000048, 0x00050041, 0x00000021, 0x0000004a, 0x00000005,
+        0x0000001d, 0x0004003d, 0x00000014, 0x0000004b, 0x0000004a, 0x00050051, 0x00000012, 0x0000004c,
+        0x0000004b, 0x00000000, 0x00050051, 0x00000012, 0x0000004d, 0x0000004b, 0x00000001, 0x00050051,
+        0x00000012, 0x0000004e, 0x0000004b, 0x00000002, 0x00050051, 0x00000012, 0x0000004f, 0x0000004b,
+        0x00000003, 0x00050081, 0x00000012, 0x00000050, 0x00000040, 0x00000049, 0x00050083, 0x00000012,
+        0x00000051, 0x00000040, 0x00000049, 0x00050081, 0x00000012, 0x00000052, 0x00000041, 0x00000049,
+        0x00050083, 0x00000012, 0x00000053, 0x00000041, 0x00000049, 0x000500be, 0x0000000f, 0x00000054,
+        0x00000050, 0x0000004c, 0x000500bc, 0x0000000f, 0x00000055, 0x00000051, 0x0000004e, 0x000500be,
+        0x0000000f, 0x00000056, 0x00000052, 0x0000004d, 0x000500bc, 0x0000000f, 0x00000057, 0x00000053,
+        0x0000004f, 0x000500a7, 0x0000000f, 0x00000058, 0x00000054, 0x00000055, 0x000500a7, 0x0000000f,
+        0x00000059, 0x00000056, 0x00000057, 0x000500a7, 0x0000000f, 0x0000005a, 0x00000058, 0x00000059,
+        0x000300f7, 0x0000005b, 0x00000000, 0x000400fa, 0x0000005a, 0x0000005c, 0x0000005b, 0x000200f8,
+        0x0000005c, 0x00050041, 0x00000027, 0x0000005d, 0x0000000b, 0x0000001e, 0x000700ea, 0x00000010,
+        0x0000005e, 0x0000005d, 0x00000018, 0x00000017, 0x00000018, 0x00050084, 0x00000010, 0x0000005f,
+        0x0000005e, 0x0000001c, 0x00050080, 0x00000010, 0x00000060, 0x0000005f, 0x00000017, 0x00050080,
+        0x00000010, 0x00000061, 0x0000005f, 0x00000018, 0x00050080, 0x00000010, 0x00000062, 0x0000005f,
+        0x00000019, 0x00050080, 0x00000010, 0x00000063, 0x0000005f, 0x0000001a, 0x00050080, 0x00000010,
+        0x00000064, 0x0000005f, 0x0000001b, 0x00060041, 0x00000027, 0x00000065, 0x00000009, 0x0000001d,
+        0x00000060, 0x00060041, 0x00000027, 0x00000066, 0x00000009, 0x0000001d, 0x00000061, 0x00060041,
+        0x00000027, 0x00000067, 0x00000009, 0x0000001d, 0x00000062, 0x00060041, 0x00000027, 0x00000068,
+        0x00000009, 0x0000001d, 0x00000063, 0x00060041, 0x00000027, 0x00000069, 0x00000009, 0x0000001d,
+        0x00000064, 0x0003003e, 0x00000065, 0x0000003b, 0x0003003e, 0x00000066, 0x0000003c, 0x0003003e,
+        0x00000067, 0x0000003d, 0x0003003e, 0x00000068, 0x0000003e, 0x0003003e, 0x00000069, 0x0000003f,
+        0x000200f9, 0x0000005b, 0x000200f8, 0x0000005b, 0x000200f9, 0x0000002e, 0x000200f8, 0x0000002e,
+        0x000100fd, 0x00010038,
+    };
+}
@@ -4,9 +4,33 @@
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
+// Per instance attributes. (binding 1, VK_VERTEX_INPUT_RATE_INSTANCE)
+layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in vec2 instanceScale;
+layout(location = 4) in vec4 instanceColor;
+
 layout(location = 0) out vec3 fragColor;
 
+// Maps quantized positions back into the mesh bounds. (identity for float positions)
+layout(push_constant) uniform VertexDecode {
+    vec2 positionScale;
+    vec2 positionOffset;
+} decode;
+
+/*
+    Transforms, read from the uniform ring buffer at dynamic offsets:
+    the frame's view projection once per frame, the model matrix once per draw call.
+*/
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    mat4 viewProjection;
+} frame;
+layout(set = 0, binding = 1) uniform ObjectUniforms {
+    mat4 model;
+} object;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    vec2 position = inPosition * decode.positionScale + decode.positionOffset;
+    vec4 world = object.model * vec4(position * instanceScale + instanceOffset, 0.0, 1.0);
+    gl_Position = frame.viewProjection * world;
+    fragColor = inColor * instanceColor.rgb;
+}
@@ -1,3 +0,0 @@
-C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe shader.vert -o vert.spv
-C:/VulkanSDK/1.2.135.0/Bin32/glslc.exe shader.frag -o frag.spv
-pause
\ No newline at end of file
@@ -0,0 +1,460 @@
+#include "spirv_reflection.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// The subset of the SPIR-V specification needed for reflection.
+namespace SpirV
+{
+    const uint32_t MAGIC = 0x07230203;
+    const uint32_t HEADER_WORDS = 5;
+
+    enum Op : uint16_t
+    {
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+    };
+    enum Decoration : uint32_t
+    {
+        Block = 2,
+        BufferBlock = 3,
+        ArrayStride = 6,
+        MatrixStride = 7,
+        BuiltIn = 11,
+        Location = 30,
+        Binding = 33,
+        DescriptorSet = 34,
+        Offset = 35,
+    };
+    enum StorageClass : uint32_t
+    {
+        UniformConstant = 0,
+        Input = 1,
+        Uniform = 2,
+        PushConstant = 9,
+        StorageBuffer = 12,
+    };
+    enum ExecutionModel : uint32_t
+    {
+        Vertex = 0,
+        TessellationControl = 1,
+        TessellationEvaluation = 2,
+        Geometry = 3,
+        Fragment = 4,
+        GLCompute = 5,
+    };
+    enum Dim : uint32_t
+    {
+        DimBuffer = 5,
+        DimSubpassData = 6,
+    };
+}
+
+namespace
+{
+    // Everything known about one id.
+    struct SpirVId
+    {
+        uint16_t opcode = 0;
+        std::vector<uint32_t> operands; // Words after the result id.
+        uint32_t constant = 0; // OpConstant value (low word).
+
+        bool hasLocation = false, hasBinding = false, hasSet = false;
+        uint32_t location = 0, binding = 0, set = 0;
+        bool builtIn = false, block = false, bufferBlock = false;
+        uint32_t arrayStride = 0;
+        std::vector<uint32_t> memberOffsets;
+        std::vector<uint32_t> memberMatrixStrides;
+    };
+
+    class Module
+    {
+    public:
+        std::unordered_map<uint32_t, SpirVId> ids;
+        std::vector<uint32_t> variables;
+
+        const SpirVId& get(uint32_t id) const
+        {
+            auto it = ids.find(id);
+            if (it == ids.end())
+                throw std::runtime_error("SPIR-V refers to undefined id " + std::to_string(id) + ".");
+            return it->second;
+        }
+
+        // Size in bytes of a type in a buffer or push constant block.
+        uint32_t getTypeSize(uint32_t typeId, uint32_t matrixStride = 0) const
+        {
+            const SpirVId& type = get(typeId);
+            switch (type.opcode)
+            {
+            case SpirV::OpTypeInt:
+            case SpirV::OpTypeFloat:
+                return type.operands[0] / 8;
+            case SpirV::OpTypeVector:
+                return type.operands[1] * getTypeSize(type.operands[0]);
+            case SpirV::OpTypeMatrix:
+                return type.operands[1] * (matrixStride ? matrixStride : getTypeSize(type.operands[0]));
+            case SpirV::OpTypeArray:
+            {
+                uint32_t length = get(type.operands[1]).constant;
+                return length * (type.arrayStride ? type.arrayStride : getTypeSize(type.operands[0]));
+            }
+            case SpirV::OpTypeRuntimeArray:
+                return 0; // Sized by the buffer bound at draw time.
+            case SpirV::OpTypeStruct:
+            {
+                uint32_t size = 0;
+                for (size_t member = 0; member < type.operands.size(); member++)
+                {
+                    uint32_t offset = member < type.memberOffsets.size() ? type.memberOffsets[member] : 0;
+                    uint32_t stride = member < type.memberMatrixStrides.size() ? type.memberMatrixStrides[member] : 0;
+                    size = std::max(size, offset + getTypeSize(type.operands[member], stride));
+                }
+                return size;
+            }
+            default:
+                throw std::runtime_error("SPIR-V type of unknown size in a buffer block.");
+            }
+        }
+
+        NumericType getNumericType(uint32_t typeId) const
+        {
+            const SpirVId& type = get(typeId);
+            if (type.opcode == SpirV::OpTypeVector || type.opcode == SpirV::OpTypeMatrix || type.opcode == SpirV::OpTypeArray)
+                return getNumericType(type.operands[0]);
+            if (type.opcode == SpirV::OpTypeInt)
+                return type.operands[1] ? NumericType::Sint : NumericType::Uint;
+            return NumericType::Float;
+        }
+
+        VkDescriptorType getDescriptorType(const SpirVId& type, uint32_t storageClass) const
+        {
+            switch (type.opcode)
+            {
+            case SpirV::OpTypeStruct:
+                if (storageClass == SpirV::StorageBuffer || type.bufferBlock)
+                    return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            case SpirV::OpTypeSampler:
+                return VK_DESCRIPTOR_TYPE_SAMPLER;
+            case SpirV::OpTypeSampledImage:
+                return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            case SpirV::OpTypeImage:
+            {
+                // Operands: sampled type, dim, depth, arrayed, multisampled, sampled (1: sampled, 2: storage), format.
+                uint32_t dim = type.operands[1];
+                bool storage = type.operands[5] == 2;
+                if (dim == SpirV::DimSubpassData)
+                    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                if (dim == SpirV::DimBuffer)
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            default:
+                throw std::runtime_error("SPIR-V resource of unknown descriptor type.");
+            }
+        }
+    };
+
+    VkShaderStageFlagBits getStage(uint32_t executionModel)
+    {
+        switch (executionModel)
+        {
+        case SpirV::Vertex: return VK_SHADER_STAGE_VERTEX_BIT;
+        case SpirV::TessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case SpirV::TessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case SpirV::Geometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case SpirV::Fragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case SpirV::GLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: throw std::runtime_error("SPIR-V entry point of unsupported execution model.");
+        }
+    }
+
+    // Formats with integer components are read as ints, all others (including the scaled formats) as floats.
+    NumericType getFormatNumericType(VkFormat format)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_R8_UINT:
+        case VK_FORMAT_R8G8_UINT:
+        case VK_FORMAT_R8G8B8_UINT:
+        case VK_FORMAT_B8G8R8_UINT:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_B8G8R8A8_UINT:
+        case VK_FORMAT_A8B8G8R8_UINT_PACK32:
+        case VK_FORMAT_A2R10G10B10_UINT_PACK32:
+        case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+        case VK_FORMAT_R16_UINT:
+        case VK_FORMAT_R16G16_UINT:
+        case VK_FORMAT_R16G16B16_UINT:
+        case VK_FORMAT_R16G16B16A16_UINT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32G32_UINT:
+        case VK_FORMAT_R32G32B32_UINT:
+        case VK_FORMAT_R32G32B32A32_UINT:
+        case VK_FORMAT_R64_UINT:
+        case VK_FORMAT_R64G64_UINT:
+        case VK_FORMAT_R64G64B64_UINT:
+        case VK_FORMAT_R64G64B64A64_UINT:
+            return NumericType::Uint;
+        case VK_FORMAT_R8_SINT:
+        case VK_FORMAT_R8G8_SINT:
+        case VK_FORMAT_R8G8B8_SINT:
+        case VK_FORMAT_B8G8R8_SINT:
+        case VK_FORMAT_R8G8B8A8_SINT:
+        case VK_FORMAT_B8G8R8A8_SINT:
+        case VK_FORMAT_A8B8G8R8_SINT_PACK32:
+        case VK_FORMAT_A2R10G10B10_SINT_PACK32:
+        case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+        case VK_FORMAT_R16_SINT:
+        case VK_FORMAT_R16G16_SINT:
+        case VK_FORMAT_R16G16B16_SINT:
+        case VK_FORMAT_R16G16B16A16_SINT:
+        case VK_FORMAT_R32_SINT:
+        case VK_FORMAT_R32G32_SINT:
+        case VK_FORMAT_R32G32B32_SINT:
+        case VK_FORMAT_R32G32B32A32_SINT:
+        case VK_FORMAT_R64_SINT:
+        case VK_FORMAT_R64G64_SINT:
+        case VK_FORMAT_R64G64B64_SINT:
+        case VK_FORMAT_R64G64B64A64_SINT:
+            return NumericType::Sint;
+        default:
+            return NumericType::Float;
+        }
+    }
+}
+
+ShaderReflection ShaderReflection::reflect(const uint32_t* code, size_t codeSize)
+{
+    size_t wordCount = codeSize / 4;
+    if (codeSize % 4 != 0 || wordCount < SpirV::HEADER_WORDS || code[0] != SpirV::MAGIC)
+        throw std::runtime_error("Shader code is not SPIR-V.");
+
+    Module module;
+    bool hasEntryPoint = false;
+    ShaderReflection reflection;
+
+    /*
+        A SPIR-V module is a header followed by instructions.
+        The first word of every instruction holds its length in words (high 16 bits) and its opcode (low 16 bits).
+        Types, constants, variables and decorations all come before the function bodies,
+        but decorations come before the ids they decorate, so ids are collected first and interpreted afterwards.
+    */
+    for (size_t i = SpirV::HEADER_WORDS; i < wordCount;)
+    {
+        uint16_t opcode = static_cast<uint16_t>(code[i] & 0xffff);
+        uint32_t length = code[i] >> 16;
+        if (length == 0 || i + length > wordCount)
+            throw std::runtime_error("SPIR-V instruction runs past the end of the code.");
+        const uint32_t* operands = code + i + 1;
+        uint32_t operandCount = length - 1;
+
+        switch (opcode)
+        {
+        case SpirV::OpEntryPoint:
+            // Modules with several entry points are reflected by their first one.
+            if (!hasEntryPoint && operandCount >= 2)
+            {
+                reflection.stage = getStage(operands[0]);
+                hasEntryPoint = true;
+            }
+            break;
+        case SpirV::OpTypeInt:
+        case SpirV::OpTypeFloat:
+        case SpirV::OpTypeVector:
+        case SpirV::OpTypeMatrix:
+        case SpirV::OpTypeImage:
+        case SpirV::OpTypeSampler:
+        case SpirV::OpTypeSampledImage:
+        case SpirV::OpTypeArray:
+        case SpirV::OpTypeRuntimeArray:
+        case SpirV::OpTypeStruct:
+        case SpirV::OpTypePointer:
+            if (operandCount >= 1)
+            {
+                SpirVId& id = module.ids[operands[0]];
+                id.opcode = opcode;
+                id.operands.assign(operands + 1, operands + operandCount);
+            }
+            break;
+        case SpirV::OpConstant:
+            if (operandCount >= 3)
+            {
+                SpirVId& id = module.ids[operands[1]];
+                id.opcode = opcode;
+                id.constant = operands[2];
+            }
+            break;
+        case SpirV::OpVariable:
+            if (operandCount >= 3)
+            {
+                // Operands: result type, result id, storage class.
+                SpirVId& id = module.ids[operands[1]];
+                id.opcode = opcode;
+                id.operands = { operands[0], operands[2] };
+                module.variables.push_back(operands[1]);
+            }
+            break;
+        case SpirV::OpDecorate:
+            if (operandCount >= 2)
+            {
+                SpirVId& id = module.ids[operands[0]];
+                uint32_t value = operandCount >= 3 ? operands[2] : 0;
+                switch (operands[1])
+                {
+                case SpirV::Block: id.block = true; break;
+                case SpirV::BufferBlock: id.bufferBlock = true; break;
+                case SpirV::ArrayStride: id.arrayStride = value; break;
+                case SpirV::BuiltIn: id.builtIn = true; break;
+                case SpirV::Location: id.hasLocation = true; id.location = value; break;
+                case SpirV::Binding: id.hasBinding = true; id.binding = value; break;
+                case SpirV::DescriptorSet: id.hasSet = true; id.set = value; break;
+                }
+            }
+            break;
+        case SpirV::OpMemberDecorate:
+            if (operandCount >= 4)
+            {
+                SpirVId& id = module.ids[operands[0]];
+                uint32_t member = operands[1];
+                if (operands[2] == SpirV::Offset)
+                {
+                    if (id.memberOffsets.size() <= member)
+                        id.memberOffsets.resize(member + 1, 0);
+                    id.memberOffsets[member] = operands[3];
+                }
+                else if (operands[2] == SpirV::MatrixStride)
+                {
+                    if (id.memberMatrixStrides.size() <= member)
+                        id.memberMatrixStrides.resize(member + 1, 0);
+                    id.memberMatrixStrides[member] = operands[3];
+                }
+                else if (operands[2] == SpirV::BuiltIn)
+                {
+                    id.builtIn = true; // Blocks of built-ins such as gl_PerVertex.
+                }
+            }
+            break;
+        }
+        i += length;
+    }
+    if (!hasEntryPoint)
+        throw std::runtime_error("SPIR-V has no entry point.");
+
+    uint32_t pushConstantEnd = 0;
+    for (uint32_t variableId : module.variables)
+    {
+        const SpirVId& variable = module.get(variableId);
+        uint32_t storageClass = variable.operands[1];
+        const SpirVId& pointer = module.get(variable.operands[0]);
+        uint32_t typeId = pointer.operands[1];
+        const SpirVId* type = &module.get(typeId);
+
+        if (storageClass == SpirV::Input)
+        {
+            if (variable.builtIn || type->builtIn || !variable.hasLocation)
+                continue;
+
+            // Arrays and matrices take one location per element or column.
+            uint32_t locationCount = 1;
+            if (type->opcode == SpirV::OpTypeArray)
+            {
+                locationCount = module.get(type->operands[1]).constant;
+                typeId = type->operands[0];
+                type = &module.get(typeId);
+            }
+            if (type->opcode == SpirV::OpTypeMatrix)
+            {
+                locationCount *= type->operands[1];
+                typeId = type->operands[0];
+                type = &module.get(typeId);
+            }
+
+            ShaderInput input;
+            input.componentCount = type->opcode == SpirV::OpTypeVector ? type->operands[1] : 1;
+            input.numericType = module.getNumericType(typeId);
+            for (uint32_t l = 0; l < locationCount; l++)
+            {
+                input.location = variable.location + l;
+                reflection.inputs.push_back(input);
+            }
+        }
+        else if (storageClass == SpirV::Uniform || storageClass == SpirV::UniformConstant || storageClass == SpirV::StorageBuffer)
+        {
+            ShaderDescriptorBinding binding;
+            binding.set = variable.set;
+            binding.binding = variable.binding;
+            if (type->opcode == SpirV::OpTypeArray)
+            {
+                binding.descriptorCount = module.get(type->operands[1]).constant;
+                type = &module.get(type->operands[0]);
+            }
+            else if (type->opcode == SpirV::OpTypeRuntimeArray)
+            {
+                throw std::runtime_error("Runtime sized descriptor arrays are not supported.");
+            }
+            binding.descriptorType = module.getDescriptorType(*type, storageClass);
+            reflection.descriptorBindings.push_back(binding);
+        }
+        else if (storageClass == SpirV::PushConstant)
+        {
+            // Only the bytes between the first and the last member are part of the range.
+            uint32_t start = UINT32_MAX;
+            for (uint32_t offset : type->memberOffsets)
+                start = std::min(start, offset);
+            reflection.pushConstantOffset = start == UINT32_MAX ? 0 : start;
+            pushConstantEnd = module.getTypeSize(typeId);
+        }
+    }
+    if (pushConstantEnd > reflection.pushConstantOffset)
+        reflection.pushConstantSize = pushConstantEnd - reflection.pushConstantOffset;
+
+    std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+        [](const ShaderInput& a, const ShaderInput& b) { return a.location < b.location; });
+    std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(),
+        [](const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b)
+        { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+    return reflection;
+}
+
+void ShaderReflection::validateVertexInput(const VkPipelineVertexInputStateCreateInfo& vertexInput) const
+{
+    for (const ShaderInput& input : inputs)
+    {
+        const VkVertexInputAttributeDescription* attribute = nullptr;
+        for (uint32_t i = 0; i < vertexInput.vertexAttributeDescriptionCount; i++)
+        {
+            if (vertexInput.pVertexAttributeDescriptions[i].location == input.location)
+                attribute = &vertexInput.pVertexAttributeDescriptions[i];
+        }
+        if (attribute == nullptr)
+            throw std::runtime_error("Vertex shader input at location " + std::to_string(input.location) + " has no vertex attribute.");
+
+        bool hasBinding = false;
+        for (uint32_t i = 0; i < vertexInput.vertexBindingDescriptionCount; i++)
+            hasBinding |= vertexInput.pVertexBindingDescriptions[i].binding == attribute->binding;
+        if (!hasBinding)
+            throw std::runtime_error("Vertex attribute at location " + std::to_string(input.location) + " reads a binding that is not described.");
+
+        // The format may have more or fewer components than the input, but it must be the same kind of number.
+        if (getFormatNumericType(attribute->format) != input.numericType)
+            throw std::runtime_error("Vertex attribute at location " + std::to_string(input.location) + " has a format of another numeric type than the shader input.");
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Numeric type of a shader input or a vertex format, as seen by the shader.
+enum class NumericType
+{
+    Float, // Also UNORM, SNORM and SFLOAT formats.
+    Sint,
+    Uint,
+};
+
+// Vertex shader input, or the input of any stage except built-ins.
+struct ShaderInput
+{
+    uint32_t location = 0;
+    uint32_t componentCount = 1;
+    NumericType numericType = NumericType::Float;
+};
+
+struct ShaderDescriptorBinding
+{
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uint32_t descriptorCount = 1;
+};
+
+/*
+    Interface of a SPIR-V module, read directly from the binary:
+    the stage of its entry point, its inputs, the resources it binds
+    and the bytes of push constants it reads.
+    Only what pipeline creation needs is parsed, everything else is skipped.
+*/
+struct ShaderReflection
+{
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::vector<ShaderInput> inputs; // Sorted by location.
+    std::vector<ShaderDescriptorBinding> descriptorBindings; // Sorted by set and binding.
+    uint32_t pushConstantOffset = 0; // First byte read from the push constant block.
+    uint32_t pushConstantSize = 0; // 0 without push constants.
+
+    // Throws if the code is not valid SPIR-V or has no entry point.
+    static ShaderReflection reflect(const uint32_t* code, size_t codeSize);
+
+    /*
+        Checks that the vertex input state provides every input of this vertex shader
+        with a format of the same numeric type, throws if not.
+    */
+    void validateVertexInput(const VkPipelineVertexInputStateCreateInfo& vertexInput) const;
+};
@@ -0,0 +1,112 @@
+#include "task_graph.h"
+
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<void()> function,
+    const std::vector<TaskId>& dependencies, bool mainThread)
+{
+    TaskId id = static_cast<TaskId>(tasks.size());
+    Task task;
+    task.name = name;
+    task.function = std::move(function);
+    task.mainThread = mainThread;
+    task.timing.name = name;
+    for (TaskId dependency : dependencies)
+    {
+        if (dependency >= id)
+            throw std::runtime_error("Task " + name + " depends on a task that was not added before it.");
+        tasks[dependency].dependents.push_back(id);
+        task.remainingDependencies++;
+    }
+    tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::run(uint32_t workerCount)
+{
+    startTime = std::chrono::steady_clock::now();
+    finishedTasks = 0;
+    error = nullptr;
+    ready.clear();
+    for (TaskId id = 0; id < tasks.size(); id++)
+    {
+        if (tasks[id].remainingDependencies == 0)
+            ready.push_back(id);
+    }
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < workerCount; i++)
+        workers.emplace_back(&TaskGraph::execute, this, false);
+    execute(true);
+    for (std::thread& worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void TaskGraph::execute(bool onMainThread)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        // Tasks pinned to the main thread go first there, so they never wait for a worker task.
+        std::deque<TaskId>::iterator next;
+        taskReady.wait(lock, [&]
+        {
+            if (error || finishedTasks == tasks.size())
+                return true;
+            next = std::find_if(ready.begin(), ready.end(), [&](TaskId id) { return tasks[id].mainThread; });
+            if (!onMainThread || next == ready.end())
+                next = std::find_if(ready.begin(), ready.end(), [&](TaskId id) { return onMainThread || !tasks[id].mainThread; });
+            return next != ready.end();
+        });
+        // After a failure no new tasks are started, the ones already running finish.
+        if (error || finishedTasks == tasks.size())
+            return;
+
+        TaskId id = *next;
+        ready.erase(next);
+        Task& task = tasks[id];
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        std::exception_ptr taskError;
+        try
+        {
+            task.function();
+        }
+        catch (...)
+        {
+            taskError = std::current_exception();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        lock.lock();
+        task.timing.startMs = std::chrono::duration<double, std::milli>(start - startTime).count();
+        task.timing.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+        task.done = true;
+        finishedTasks++;
+        if (taskError && !error)
+            error = taskError;
+        for (TaskId dependent : task.dependents)
+        {
+            if (--tasks[dependent].remainingDependencies == 0)
+                ready.push_back(dependent);
+        }
+        taskReady.notify_all();
+    }
+}
+
+std::vector<TaskTiming> TaskGraph::getTimings() const
+{
+    std::vector<TaskTiming> timings;
+    for (const Task& task : tasks)
+    {
+        if (task.done)
+            timings.push_back(task.timing);
+    }
+    return timings;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <chrono>
+
+struct TaskTiming
+{
+    std::string name;
+    double startMs = 0.0; // Since run() started.
+    double durationMs = 0.0;
+};
+
+/*
+    Set of tasks with dependencies between them, run as parallel as the dependencies allow.
+    A task starts once all tasks it depends on have finished. Tasks marked mainThread only
+    run on the thread that calls run(), for APIs such as GLFW that require it.
+    Dependencies can only be on tasks added earlier, so the graph can't have cycles.
+*/
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+
+    TaskId add(const std::string& name, std::function<void()> function,
+        const std::vector<TaskId>& dependencies = {}, bool mainThread = false);
+
+    // Runs every task once, on workerCount new threads and the calling thread. Rethrows the first exception of a task.
+    void run(uint32_t workerCount);
+
+    // Start and duration of every task that ran, in the order they were added.
+    std::vector<TaskTiming> getTimings() const;
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::function<void()> function;
+        std::vector<TaskId> dependents;
+        uint32_t remainingDependencies = 0;
+        bool mainThread = false;
+        bool done = false;
+        TaskTiming timing;
+    };
+
+    std::vector<Task> tasks;
+    std::deque<TaskId> ready;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    size_t finishedTasks = 0;
+    std::exception_ptr error;
+    std::chrono::steady_clock::time_point startTime;
+
+    void execute(bool onMainThread);
+};
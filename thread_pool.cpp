@@ -0,0 +1,80 @@
+#include "thread_pool.h"
+
+void ThreadPool::start(uint32_t threadCount)
+{
+    stopping = false;
+    for (uint32_t i = 0; i < threadCount; i++)
+        threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+    threads.clear();
+}
+void ThreadPool::run(uint32_t count, const std::function<void(uint32_t index)>& task)
+{
+    if (count == 0)
+        return;
+
+    // Nothing to parallelize, skip the hand-off.
+    if (threads.empty() || count == 1)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    currentTask = &task;
+    taskCount = count;
+    nextTask = 0;
+    finishedTasks = 0;
+    error = nullptr;
+    generation++;
+    workAvailable.notify_all();
+
+    workDone.wait(lock, [this] { return finishedTasks == taskCount; });
+    currentTask = nullptr;
+
+    if (error)
+        std::rethrow_exception(error);
+}
+void ThreadPool::workerLoop()
+{
+    uint64_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workAvailable.wait(lock, [&] { return stopping || (generation != seenGeneration && nextTask < taskCount); });
+        if (stopping)
+            return;
+
+        // Take task indices until there are none left in this run.
+        while (nextTask < taskCount)
+        {
+            uint32_t index = nextTask++;
+            const std::function<void(uint32_t)>& task = *currentTask;
+            lock.unlock();
+            try
+            {
+                task(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> errorLock(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+            lock.lock();
+            if (++finishedTasks == taskCount)
+                workDone.notify_one();
+        }
+        seenGeneration = generation;
+    }
+}
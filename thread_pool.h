@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*
+    Fixed set of worker threads that run indexed tasks in parallel.
+    run() hands out the task indices to the workers and blocks until all of them are done,
+    so the caller can rely on everything written by the tasks afterwards.
+*/
+class ThreadPool
+{
+public:
+    void start(uint32_t threadCount);
+    void stop();
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+    // Runs task(index) for every index in [0, count). Exceptions thrown by a task are rethrown here.
+    void run(uint32_t count, const std::function<void(uint32_t index)>& task);
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+
+    const std::function<void(uint32_t)>* currentTask = nullptr;
+    uint32_t taskCount = 0;
+    uint32_t nextTask = 0;
+    uint32_t finishedTasks = 0;
+    uint64_t generation = 0; // Incremented by every run() so workers notice new work.
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void workerLoop();
+};
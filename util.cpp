@@ -1,6 +1,115 @@
 #include "util.h"
 
 #include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileView::FileView(const std::string& filename)
+{
+    if (!map(filename))
+        buffer = Util::readFile(filename);
+}
+FileView::~FileView()
+{
+    unmap();
+}
+FileView::FileView(FileView&& other) noexcept
+{
+    *this = std::move(other);
+}
+FileView& FileView::operator=(FileView&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        mapped = other.mapped;
+        mappedSize = other.mappedSize;
+        buffer = std::move(other.buffer);
+#ifdef _WIN32
+        mappingHandle = other.mappingHandle;
+        other.mappingHandle = nullptr;
+#endif
+        other.mapped = nullptr;
+        other.mappedSize = 0;
+    }
+    return *this;
+}
+
+// Maps the whole file read-only. Returns false if the file can't be mapped, e.g. empty files.
+bool FileView::map(const std::string& filename)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping keeps the file open.
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return false;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+    mapped = static_cast<const char*>(view);
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    mappingHandle = mapping;
+    return true;
+#else
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    void* view = MAP_FAILED;
+    if (fstat(file, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+        view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps the file open.
+    close(file);
+    if (view == MAP_FAILED)
+        return false;
+
+    // Files are read front to back, let the OS read ahead.
+    posix_madvise(view, static_cast<size_t>(status.st_size), POSIX_MADV_SEQUENTIAL);
+    mapped = static_cast<const char*>(view);
+    mappedSize = static_cast<size_t>(status.st_size);
+    return true;
+#endif
+}
+void FileView::unmap()
+{
+    if (mapped == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(const_cast<char*>(mapped), mappedSize);
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
 
 // Read binary data from file.
 std::vector<char> Util::readFile(const std::string& filename)
@@ -36,3 +145,61 @@ std::vector<char> Util::readFile(const std::string& filename)
     // Return the bytes.
     return buffer;
 }
+// Map a file into memory without copying it, see FileView.
+FileView Util::mapFile(const std::string& filename)
+{
+    return FileView(filename);
+}
+bool Util::fileExists(const std::string& filename)
+{
+    std::error_code error;
+    return std::filesystem::is_regular_file(filename, error);
+}
+
+// Write binary data to a file, readers never see a partially written file.
+void Util::writeFileAtomic(const std::string& filename, const std::vector<char>& data)
+{
+    /*
+        Write everything to a temporary file next to the target first,
+        then replace the target with a rename. If the process dies while writing,
+        the old file stays intact.
+    */
+    std::string tempFilename = filename + ".tmp";
+    {
+        std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open file: " + tempFilename);
+        }
+
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write file: " + tempFilename);
+        }
+    }
+
+    /*
+        The rename may reach the disk before the data does, a crash in between would leave
+        an empty or truncated file under the target name. Flush the data to disk first.
+    */
+#ifdef _WIN32
+    HANDLE file = CreateFileA(tempFilename.c_str(), GENERIC_WRITE, 0, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    bool flushed = file != INVALID_HANDLE_VALUE && FlushFileBuffers(file);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    int file = open(tempFilename.c_str(), O_WRONLY);
+    bool flushed = file >= 0 && fsync(file) == 0;
+    if (file >= 0)
+        close(file);
+#endif
+    if (!flushed)
+    {
+        throw std::runtime_error("Failed to flush file: " + tempFilename);
+    }
+
+    std::filesystem::rename(tempFilename, filename);
+}
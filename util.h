@@ -2,9 +2,51 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Read-only view of a whole file.
+    The file is memory mapped, so its pages are loaded by the OS as they are touched and shared with
+    the page cache instead of being copied into a heap buffer. If mapping fails, the file is read
+    into a buffer instead. Either way data() is at least 4 byte aligned, so SPIR-V can be passed
+    to vkCreateShaderModule and buffers to the staging upload without another copy.
+    The view owns the mapping and releases it when destroyed.
+*/
+class FileView
+{
+public:
+    FileView() = default;
+    explicit FileView(const std::string& filename);
+    ~FileView();
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+    FileView(FileView&& other) noexcept;
+    FileView& operator=(FileView&& other) noexcept;
+
+    const char* data() const { return mapped ? mapped : buffer.data(); }
+    size_t size() const { return mapped ? mappedSize : buffer.size(); }
+    bool empty() const { return size() == 0; }
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::vector<char> buffer; // Fallback when the file can't be mapped.
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+
+    bool map(const std::string& filename);
+    void unmap();
+};
 
 class Util
 {
 public:
     static std::vector<char> readFile(const std::string& filename);
+    static FileView mapFile(const std::string& filename);
+    static bool fileExists(const std::string& filename);
+    static void writeFileAtomic(const std::string& filename, const std::vector<char>& data);
 };
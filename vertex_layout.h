@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+    Compile time vertex input layouts.
+    Instead of filling VkVertexInputBindingDescription and VkVertexInputAttributeDescription by hand,
+    a vertex type lists its members once:
+
+        VERTEX_ATTRIBUTES(Vertex,
+            VERTEX_ATTRIBUTE(Vertex, pos),
+            VERTEX_ATTRIBUTE(Vertex, color));
+
+    and a layout combines vertex types into bindings:
+
+        using Layout = VertexLayout<PerVertex<Vertex>, PerInstance<InstanceData>>;
+
+    Bindings are numbered in the order they are listed, locations count up over all attributes
+    of all bindings. Layout::bindings, Layout::attributes and Layout::inputState are constexpr,
+    so the pipeline reads them straight from read-only data.
+*/
+
+// Format of a member, deduced from its type. Members whose type has no default use VERTEX_ATTRIBUTE_FORMAT.
+template <typename T> struct DefaultVertexFormat;
+template <> struct DefaultVertexFormat<float> { static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+template <> struct DefaultVertexFormat<glm::vec2> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+template <> struct DefaultVertexFormat<glm::vec3> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+template <> struct DefaultVertexFormat<glm::vec4> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template <> struct DefaultVertexFormat<int32_t> { static constexpr VkFormat value = VK_FORMAT_R32_SINT; };
+template <> struct DefaultVertexFormat<uint32_t> { static constexpr VkFormat value = VK_FORMAT_R32_UINT; };
+
+// Size in bytes of the vertex formats used in layouts, 0 for formats that are not listed.
+constexpr uint32_t getVertexFormatSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+    case VK_FORMAT_R8G8B8A8_UINT:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32_UINT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R16G16B16A16_SNORM:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+struct VertexAttribute
+{
+    uint32_t offset;
+    VkFormat format;
+    uint32_t size; // Size of the member, the format must not read past it.
+};
+
+#define VERTEX_ATTRIBUTE(Type, member) \
+    VertexAttribute{ offsetof(Type, member), DefaultVertexFormat<decltype(Type::member)>::value, sizeof(Type::member) }
+#define VERTEX_ATTRIBUTE_FORMAT(Type, member, format) \
+    VertexAttribute{ offsetof(Type, member), format, sizeof(Type::member) }
+
+// Attributes of a vertex type, specialized by VERTEX_ATTRIBUTES.
+template <typename T> struct VertexAttributes;
+#define VERTEX_ATTRIBUTES(Type, ...) \
+    template <> struct VertexAttributes<Type> { static constexpr std::array value{ __VA_ARGS__ }; }
+// A second attribute list for the same type, e.g. the same bytes read in another format.
+#define VERTEX_ATTRIBUTE_SET(Name, ...) \
+    struct Name { static constexpr std::array value{ __VA_ARGS__ }; }
+
+template <typename T, VkVertexInputRate Rate, typename Attributes = VertexAttributes<T>>
+struct VertexBinding
+{
+    static constexpr uint32_t stride = sizeof(T);
+    static constexpr VkVertexInputRate inputRate = Rate;
+    static constexpr auto& attributes = Attributes::value;
+
+    static constexpr bool isValid()
+    {
+        for (const VertexAttribute& attribute : attributes)
+        {
+            uint32_t formatSize = getVertexFormatSize(attribute.format);
+            if (formatSize == 0 || formatSize > attribute.size || attribute.offset + formatSize > stride)
+                return false;
+        }
+        return true;
+    }
+    static_assert(isValid(), "Vertex attribute format is unknown or larger than its member.");
+};
+template <typename T, typename Attributes = VertexAttributes<T>>
+using PerVertex = VertexBinding<T, VK_VERTEX_INPUT_RATE_VERTEX, Attributes>;
+template <typename T, typename Attributes = VertexAttributes<T>>
+using PerInstance = VertexBinding<T, VK_VERTEX_INPUT_RATE_INSTANCE, Attributes>;
+
+template <typename... Bindings>
+struct VertexLayout
+{
+    static constexpr uint32_t bindingCount = sizeof...(Bindings);
+    static constexpr uint32_t attributeCount = (0 + ... + static_cast<uint32_t>(Bindings::attributes.size()));
+
+    static constexpr std::array<VkVertexInputBindingDescription, bindingCount> makeBindings()
+    {
+        std::array<VkVertexInputBindingDescription, bindingCount> result{};
+        uint32_t binding = 0;
+        ((result[binding] = { binding, Bindings::stride, Bindings::inputRate }, binding++), ...);
+        return result;
+    }
+    static constexpr std::array<VkVertexInputAttributeDescription, attributeCount> makeAttributes()
+    {
+        std::array<VkVertexInputAttributeDescription, attributeCount> result{};
+        uint32_t binding = 0;
+        uint32_t location = 0;
+        auto addBinding = [&](const auto& attributes)
+        {
+            for (const VertexAttribute& attribute : attributes)
+            {
+                result[location] = { location, binding, attribute.format, attribute.offset };
+                location++;
+            }
+            binding++;
+        };
+        (addBinding(Bindings::attributes), ...);
+        return result;
+    }
+
+    static constexpr std::array<VkVertexInputBindingDescription, bindingCount> bindings = makeBindings();
+    static constexpr std::array<VkVertexInputAttributeDescription, attributeCount> attributes = makeAttributes();
+
+    static constexpr VkPipelineVertexInputStateCreateInfo inputState = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr, 0,
+        bindingCount, bindings.data(),
+        attributeCount, attributes.data()
+    };
+};
@@ -5,34 +5,136 @@
 #include <set>
 #include <algorithm>
 #include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
+#include <limits>
 
 #include "util.h"
+#include "mesh.h"
+#include "shader/embedded_shaders.h"
 
 GLFWwindow* VK::window;
+int VK::width = 800, VK::height = 600;
+bool VK::headless = false;
+std::vector<Allocation> VK::offscreenImageAllocations;
+uint32_t VK::offscreenImageIndex = 0;
 VkInstance VK::instance;
 VkSurfaceKHR VK::surface;
 VkPhysicalDevice VK::physicalDevice;
+DeviceCapabilities VK::deviceCapabilities;
+QueueFamilyIndices VK::queueFamilyIndices;
+std::string VK::deviceOverride;
 VkDevice VK::logicalDevice;
+MemoryAllocator VK::allocator;
+PipelineLayoutCache VK::pipelineLayoutCache;
 VkQueue VK::graphicsQueue;
 VkQueue VK::presentQueue;
+bool VK::useDedicatedQueues = true;
+uint32_t VK::graphicsQueueFamily = 0;
+uint32_t VK::transferQueueFamily = 0;
+uint32_t VK::computeQueueFamily = 0;
+VkQueue VK::transferQueue = VK_NULL_HANDLE;
+VkQueue VK::computeQueue = VK_NULL_HANDLE;
+bool VK::dedicatedTransferQueue = false;
+bool VK::asyncCompute = false;
+VkCommandPool VK::transferCommandPool = VK_NULL_HANDLE;
+VkSemaphore VK::uploadSemaphore = VK_NULL_HANDLE;
+std::vector<VkSemaphore> VK::cullFinishedSemaphores;
 VkSwapchainKHR VK::swapchain;
 std::vector<VkImage> VK::swapchainImages;
 std::vector<VkImageView> VK::swapchainImageViews;
 VkFormat VK::swapchainImageFormat;
 VkExtent2D VK::swapchainExtent;
-VkRenderPass VK::renderPass;
-VkPipelineLayout VK::pipelineLayout;
+VkRenderPass VK::renderPass = VK_NULL_HANDLE;
+VkPipelineCache VK::pipelineCache = VK_NULL_HANDLE;
+VkPipelineLayout VK::pipelineLayout = VK_NULL_HANDLE;
 VkPipeline VK::graphicsPipeline;
 std::vector<VkFramebuffer> VK::swapchainFramebuffers;
 VkCommandPool VK::commandPool;
-std::vector<VkCommandBuffer> VK::commandBuffers;
+std::vector<FrameCommands> VK::frameCommands;
+ThreadPool VK::recordingThreads;
+int VK::recordingThreadCount = -1;
+uint32_t VK::drawCallCount = 1;
+uint32_t VK::instanceCount = 0;
+VertexFormat VK::vertexFormat = VertexFormat::Snorm16;
+VertexFormat VK::activeVertexFormat = VertexFormat::Float32;
+float VK::maxQuantizationError = 1e-4f;
+double VK::meshCacheMissRatioBefore = 0.0;
+double VK::meshCacheMissRatioAfter = 0.0;
+bool VK::parallelInit = true;
+VkPresentModeKHR VK::requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+VkPresentModeKHR VK::presentMode = VK_PRESENT_MODE_FIFO_KHR;
+uint32_t VK::requestedSwapchainImageCount = 0;
+uint32_t VK::framesInFlight = 2;
+bool VK::lowLatency = false;
+std::vector<std::chrono::steady_clock::time_point> VK::frameInputTimes;
+std::vector<TaskTiming> VK::startupTimings;
+double VK::startupMilliseconds = 0.0;
+std::string VK::shaderDirectory;
+bool VK::gpuCulling = false;
+glm::vec4 VK::cullingFrustum = glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+VkDescriptorSetLayout VK::cullDescriptorSetLayout = VK_NULL_HANDLE;
+VkPipelineLayout VK::cullPipelineLayout = VK_NULL_HANDLE;
+VkPipeline VK::cullPipeline = VK_NULL_HANDLE;
+VkDescriptorPool VK::cullDescriptorPool = VK_NULL_HANDLE;
+std::vector<VkDescriptorSet> VK::cullDescriptorSets;
+std::vector<uint64_t> VK::cullDescriptorSetVersions;
+glm::mat4 VK::viewProjection = glm::mat4(1.0f);
+std::vector<glm::mat4> VK::drawTransforms;
+RingBuffer VK::uniformRing;
+VkDescriptorSetLayout VK::uniformDescriptorSetLayout = VK_NULL_HANDLE;
+VkDescriptorPool VK::uniformDescriptorPool = VK_NULL_HANDLE;
+VkDescriptorSet VK::uniformDescriptorSet = VK_NULL_HANDLE;
+RingBuffer VK::vertexStream;
+VkDeviceSize VK::vertexStreamCapacity = 1024 * 1024;
+uint32_t VK::particleCount = 0;
 std::vector<VkSemaphore> VK::imageAvailableSemaphores;
 std::vector<VkSemaphore> VK::renderFinishedSemaphores;
 std::vector<VkFence> VK::inFlightFences;
-std::vector<VkFence> VK::imagesInFlight;
 size_t VK::currentFrame = 0;
+uint64_t VK::frameNumber = 0;
+std::vector<uint64_t> VK::frameSlotNumbers;
+std::vector<uint64_t> VK::imageFrameNumbers;
+bool VK::useTimelineSemaphores = true;
+bool VK::timelineSemaphoresEnabled = false;
+VkSemaphore VK::frameTimeline = VK_NULL_HANDLE;
+uint64_t VK::completedFrameNumber = 0;
+std::deque<DeferredDestruction> VK::deferredDestructions;
 bool VK::framebufferResized = false;
-
+FrameTimings VK::frameTimings;
+bool VK::timestampsSupported = false;
+bool VK::pipelineStatisticsSupported = false;
+float VK::timestampPeriod = 1.0f;
+uint64_t VK::timestampMask = UINT64_MAX;
+uint64_t VK::timestampCalibrationTicks = 0;
+std::chrono::steady_clock::time_point VK::timestampCalibrationTime;
+VkQueryPool VK::timestampQueryPool = VK_NULL_HANDLE;
+VkQueryPool VK::statisticsQueryPool = VK_NULL_HANDLE;
+std::vector<bool> VK::queryResultsPending;
+GpuFrameStats VK::gpuFrameStats;
+VkBuffer VK::stagingBuffer = VK_NULL_HANDLE;
+Allocation VK::stagingBufferAllocation;
+void* VK::stagingBufferMapped = nullptr;
+VkDeviceSize VK::stagingBufferSize = 0;
+VkDeviceSize VK::stagingBufferOffset = 0;
+VkCommandBuffer VK::uploadCommandBuffer = VK_NULL_HANDLE;
+std::vector<VkBufferMemoryBarrier> VK::uploadOwnershipTransfers;
+bool VK::uploadSemaphorePending = false;
+std::vector<VkCommandBuffer> VK::uploadAcquireCommandBuffers;
+
+/*
+    Swapchains replaced by recreateSwapchain(), with the semaphores their last presents wait on.
+    A frame's fence or timeline value doesn't cover its present, so these are only queued for
+    destruction once the new swapchain has presented, see queueRetiredSwapchains().
+*/
+std::vector<VkSwapchainKHR> retiredSwapchains;
+std::vector<VkSemaphore> retiredRenderFinishedSemaphores;
+
+// Triangle list as authored, shared corners are merged into an indexed mesh in createVertexBuffer().
 const std::vector<Vertex> vertices = {
     {{-0.5f, -0.5f}, {1.0f, 1.0f, 1.0f}},
     {{0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}},
@@ -42,16 +144,62 @@ const std::vector<Vertex> vertices = {
     {{0.5f, 0.5f}, {0.0f, 1.0f, 1.0f}}
 };
 VkBuffer vertexBuffer;
-VkDeviceMemory vertexBufferMemory;
+Allocation vertexBufferAllocation;
+VkBuffer indexBuffer;
+Allocation indexBufferAllocation;
+uint32_t indexCount = 0;
+VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+VkBuffer instanceBuffer = VK_NULL_HANDLE;
+Allocation instanceBufferAllocation;
+uint64_t instanceBufferVersion = 0; // Incremented whenever setInstances() replaces the buffers.
+float meshRadius = 0.0f; // Distance of the farthest vertex from the mesh origin.
+// Encoded by loadMesh() until createVertexBuffer() uploads them.
+std::vector<char> meshVertexData;
+std::vector<char> meshIndexData;
+// Matches the push constant block of shader/shader.vert.
+struct VertexPushConstants
+{
+    glm::vec2 positionScale = glm::vec2(1.0f);
+    glm::vec2 positionOffset = glm::vec2(0.0f);
+};
+VertexPushConstants vertexPushConstants;
+// Match the uniform blocks of shader/shader.vert.
+struct FrameUniforms
+{
+    glm::mat4 viewProjection;
+};
+struct ObjectUniforms
+{
+    glm::mat4 model;
+};
+// Where writeUniforms() put the current frame's uniforms in the uniform ring, read by recordDraws().
+uint32_t frameUniformOffset = 0;
+uint32_t objectUniformOffset = 0;
+uint32_t objectUniformStride = 0; // ObjectUniforms rounded up to minUniformBufferOffsetAlignment.
+uint32_t uniformRingDrawCalls = 0; // drawCallCount the uniform ring was sized for.
+/*
+    GPU culling output, one copy per frame in flight. A frame culls into its own copy while
+    the draws of the frames before it still read theirs.
+*/
+std::vector<VkBuffer> visibleInstanceBuffers;
+std::vector<Allocation> visibleInstanceBufferAllocations;
+std::vector<VkBuffer> indirectBuffers;
+std::vector<Allocation> indirectBufferAllocations;
+
+// Matches the push constant block of shader/cull.comp.
+struct CullingPushConstants
+{
+    glm::vec4 frustum;
+    uint32_t instanceCount;
+    float meshRadius;
+};
 
 void VK::initWindow()
 {
-    glfwInit();
-
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Tell GLFW to not create an OpenGL context.
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE); // Disable resizing window.
 
-    window = glfwCreateWindow(800, 600, "Vulkan", nullptr, nullptr);
+    window = glfwCreateWindow(width, height, "Vulkan", nullptr, nullptr);
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 }
 void VK::framebufferResizeCallback(GLFWwindow* window, int width, int height)
@@ -63,6 +211,12 @@ void VK::terminateWindow()
     glfwDestroyWindow(window);
     glfwTerminate();
 }
+// Set by initVulkan when the instance has VK_KHR_get_physical_device_properties2 enabled.
+bool physicalDeviceProperties2Enabled = false;
+// VK_KHR_timeline_semaphore entry points, loaded when the extension is enabled.
+PFN_vkGetSemaphoreCounterValueKHR pfnGetSemaphoreCounterValue = nullptr;
+PFN_vkWaitSemaphoresKHR pfnWaitSemaphores = nullptr;
+
 void VK::initVulkan(VkApplicationInfo info)
 {
     /*
@@ -74,11 +228,15 @@ void VK::initVulkan(VkApplicationInfo info)
     createInfo.pApplicationInfo = &info;
 
     // Enable global extensions.
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount); // GLFW built-in function: returns required extensions.
-    createInfo.enabledExtensionCount = glfwExtensionCount;
-    createInfo.ppEnabledExtensionNames = glfwExtensions;
+    std::vector<const char*> instanceExtensions;
+    if (!headless)
+    {
+        // Nothing is presented in headless mode, so no surface extensions are needed.
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount); // GLFW built-in function: returns required extensions.
+        instanceExtensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     // Enable global validation layers.
     createInfo.enabledLayerCount = 0;
@@ -99,6 +257,19 @@ void VK::initVulkan(VkApplicationInfo info)
         std::cout << '\t' << extension.extensionName << '\n';
     }
 
+    // Optional: querying extension features such as timeline semaphore support needs vkGetPhysicalDeviceFeatures2KHR.
+    physicalDeviceProperties2Enabled = false;
+    for (const auto& extension : extensions)
+    {
+        if (useTimelineSemaphores && strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+        {
+            instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+            physicalDeviceProperties2Enabled = true;
+        }
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+    createInfo.ppEnabledExtensionNames = instanceExtensions.data();
+
     /*
         Check validation layer support. (only in debug mode)
     */
@@ -139,15 +310,26 @@ void VK::destroySurface()
 {
     vkDestroySurfaceKHR(instance, surface, nullptr);
 }
-QueueFamilyIndices VK::findQueueFamilies(VkPhysicalDevice device)
+QueueFamilyIndices VK::findQueueFamilies(const DeviceCapabilities& device)
 {
     QueueFamilyIndices indices;
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr); // Get number of available queue families.
+    const std::vector<VkQueueFamilyProperties>& queueFamilies = device.queueFamilies;
+    uint32_t queueFamilyCount = static_cast<uint32_t>(queueFamilies.size());
 
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data()); // Get properties of available queue families.
+    /*
+        Families without graphics support: their queues are served by separate hardware
+        (copy engines, compute units scheduled next to graphics), so their work overlaps rendering.
+    */
+    for (uint32_t i = 0; i < queueFamilyCount; i++)
+    {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        if (!indices.transferFamily.has_value() && (flags & VK_QUEUE_TRANSFER_BIT)
+            && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            indices.transferFamily = i;
+        if (!indices.computeFamily.has_value() && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            indices.computeFamily = i;
+    }
 
     for (uint32_t i = 0; i < queueFamilyCount; i++)
     {
@@ -159,7 +341,15 @@ QueueFamilyIndices VK::findQueueFamilies(VkPhysicalDevice device)
 
         // Find queue familt that has presentation support. (presents rendered image to window)
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (headless)
+        {
+            // There is no surface in headless mode, the graphics family stands in as present family.
+            presentSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
+        else
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device.physicalDevice, i, surface, &presentSupport); // Depends on the surface, not cached.
+        }
         if (presentSupport)
         {
             indices.presentFamily = i;
@@ -173,39 +363,54 @@ QueueFamilyIndices VK::findQueueFamilies(VkPhysicalDevice device)
 
     return indices;
 }
-bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
+// Device extensions required by the current mode. (headless mode doesn't need a swapchain)
+std::vector<const char*> getRequiredDeviceExtensions()
 {
-    // Get number of supported extensions from device.
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
-
-    // Get properties of supported extensions from device.
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
-
-    // Clone list of required extensions
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-    // Check if all required extensions are listed in availableExtensions.
-    for (const auto& extension : availableExtensions)
+    if (VK::headless)
+        return {};
+    return deviceExtensions;
+}
+bool checkDeviceExtensionSupport(const DeviceCapabilities& device)
+{
+    // Check if all required extensions are listed in the device's extensions.
+    for (const char* extension : getRequiredDeviceExtensions())
     {
-        requiredExtensions.erase(extension.extensionName);
+        if (!device.hasExtension(extension))
+            return false;
     }
-
-    return requiredExtensions.empty();
+    return true;
 }
-bool isDeviceSuitable(VkPhysicalDevice physicalDevice)
+bool isDeviceSuitable(const DeviceCapabilities& device)
 {
-    QueueFamilyIndices indices = VK::findQueueFamilies(physicalDevice); // queue.cpp
+    QueueFamilyIndices indices = VK::findQueueFamilies(device); // queue.cpp
 
-    bool extensionsSupported = checkDeviceExtensionSupport(physicalDevice);
+    bool extensionsSupported = checkDeviceExtensionSupport(device);
 
     return indices.isComplete() && extensionsSupported;
 }
+/*
+    True if the override selects the device: its index in the device list, or part of its name.
+    Anything that isn't a whole number that fits an index, e.g. a long run of digits, is matched against the name.
+*/
+bool matchesDeviceOverride(const std::string& deviceOverride, uint32_t index, const DeviceCapabilities& device)
+{
+    const char* end = deviceOverride.data() + deviceOverride.size();
+    uint32_t requestedIndex = 0;
+    std::from_chars_result result = std::from_chars(deviceOverride.data(), end, requestedIndex);
+    if (result.ec == std::errc() && result.ptr == end)
+        return requestedIndex == index;
+    return std::string(device.properties.deviceName).find(deviceOverride) != std::string::npos;
+}
 void VK::selectPhysicalDevice()
 {
     physicalDevice = VK_NULL_HANDLE;
 
+    // The command line option wins over the environment variable.
+    std::string requested = deviceOverride;
+    const char* environmentOverride = std::getenv("VK_EXAMPLE_DEVICE");
+    if (requested.empty() && environmentOverride != nullptr)
+        requested = environmentOverride;
+
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr); // Get number of available devices.
     if (deviceCount == 0)
@@ -216,17 +421,37 @@ void VK::selectPhysicalDevice()
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()); // Get all available devices.
 
-    // Select first suitable device.
-    for (const auto& device : devices) {
-        if (isDeviceSuitable(device)) {
-            physicalDevice = device;
-            break;
+    /*
+        Select the suitable device with the highest score, or the one the override names.
+        The first device in the list is often the integrated GPU on machines that also have a discrete one.
+    */
+    std::cout << "available devices:\n";
+    uint64_t bestScore = 0;
+    for (uint32_t i = 0; i < deviceCount; i++)
+    {
+        DeviceCapabilities device = DeviceCapabilities::query(instance, devices[i], physicalDeviceProperties2Enabled);
+        bool suitable = isDeviceSuitable(device);
+        uint64_t score = device.getScore();
+        std::cout << '\t' << i << ": " << device.properties.deviceName << " (" << getDeviceTypeName(device.properties.deviceType)
+            << ", " << (device.deviceLocalMemory >> 20) << " MiB" << (suitable ? "" : ", not suitable") << ")\n";
+
+        if (!suitable || (!requested.empty() && !matchesDeviceOverride(requested, i, device)))
+            continue;
+        if (physicalDevice == VK_NULL_HANDLE || score > bestScore)
+        {
+            physicalDevice = devices[i];
+            bestScore = score;
+            deviceCapabilities = std::move(device);
         }
     }
     if (physicalDevice == VK_NULL_HANDLE) {
         // Throw error if there are no suitable device.
+        if (!requested.empty())
+            throw std::runtime_error("No suitable GPU matches the device override: " + requested);
         throw std::runtime_error("failed to find a suitable GPU!");
     }
+    queueFamilyIndices = findQueueFamilies(deviceCapabilities);
+    std::cout << "Using " << deviceCapabilities.properties.deviceName << ".\n";
 }
 void VK::waitIdle()
 {
@@ -234,17 +459,26 @@ void VK::waitIdle()
 }
 void VK::createLogicalDevice()
 {
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    const QueueFamilyIndices& indices = queueFamilyIndices;
+    timelineSemaphoresEnabled = useTimelineSemaphores && deviceCapabilities.timelineSemaphore;
+
+    // Work for missing dedicated queues goes to the graphics queue.
+    graphicsQueueFamily = indices.graphicsFamily.value();
+    dedicatedTransferQueue = useDedicatedQueues && indices.transferFamily.has_value();
+    transferQueueFamily = dedicatedTransferQueue ? indices.transferFamily.value() : graphicsQueueFamily;
+    asyncCompute = useDedicatedQueues && gpuCulling && timelineSemaphoresEnabled && indices.computeFamily.has_value();
+    computeQueueFamily = asyncCompute ? indices.computeFamily.value() : graphicsQueueFamily;
 
     // Create multiple queue families that are necessary for the required queue.
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos; // List of create info struct.
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() }; // required queue.
+    std::set<uint32_t> uniqueQueueFamilies = { graphicsQueueFamily, indices.presentFamily.value(),
+        transferQueueFamily, computeQueueFamily }; // required queue.
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         // Specify number of required queues(to be created) for a single family
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+        queueCreateInfo.queueFamilyIndex = queueFamily;
         queueCreateInfo.queueCount = 1;
         // Assign priorities to influence the scheduling of command buffer execution.
         queueCreateInfo.pQueuePriorities = &queuePriority;
@@ -253,12 +487,30 @@ void VK::createLogicalDevice()
     }
 
     // Specify required device features. (e.g. geometry shaders)
-    // Empty for now
+    const VkPhysicalDeviceFeatures& supportedFeatures = deviceCapabilities.features;
     VkPhysicalDeviceFeatures deviceFeatures{};
+    // Optional: vertex/fragment invocation counters.
+    pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
 
     // Create logical device.
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+    // Optional: timeline semaphores, enabled with their extension and feature.
+    std::vector<const char*> requiredExtensions = getRequiredDeviceExtensions();
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    if (timelineSemaphoresEnabled)
+    {
+        requiredExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        createInfo.pNext = &timelineFeatures;
+    }
+    else if (useTimelineSemaphores)
+    {
+        std::cout << "Timeline semaphores are not supported, using fences for frame synchronization.\n";
+    }
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -283,8 +535,8 @@ void VK::createLogicalDevice()
     */
 
     // Enable requied extensions.
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()); // physical_device.h
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size()); // physical_device.h
+    createInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
     // Enable validation layers. (in debug mode)
     if (enableValidationLayers) // layer.h
@@ -306,6 +558,19 @@ void VK::createLogicalDevice()
     // Retrieve queue handles for each queue family.
     vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(logicalDevice, transferQueueFamily, 0, &transferQueue);
+    vkGetDeviceQueue(logicalDevice, computeQueueFamily, 0, &computeQueue);
+
+    // Extension functions are not exported by the loader, their addresses are queried from the device.
+    if (timelineSemaphoresEnabled)
+    {
+        pfnGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+        pfnWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(logicalDevice, "vkWaitSemaphoresKHR"));
+        if (pfnGetSemaphoreCounterValue == nullptr || pfnWaitSemaphores == nullptr)
+            throw std::runtime_error("Failed to load VK_KHR_timeline_semaphore functions.");
+    }
 }
 void VK::destroyLogicalDevice()
 {
@@ -385,18 +650,31 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
     // Use first format if failed.
     return availableFormats[0];
 }
+const char* getPresentModeName(VkPresentModeKHR mode)
+{
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+    default: return "unknown";
+    }
+}
 VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
     for (const auto& availablePresentMode : availablePresentModes)
     {
-        // Check if VK_PRESENT_MODE_MAILBOX_KHR is available.
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        // Check if the requested mode is available.
+        if (availablePresentMode == VK::requestedPresentMode)
         {
             return availablePresentMode;
         }
     }
 
     // Only the VK_PRESENT_MODE_FIFO_KHR mode is guanranteed to be available.
+    if (VK::requestedPresentMode != VK_PRESENT_MODE_FIFO_KHR)
+        std::cout << "Present mode " << getPresentModeName(VK::requestedPresentMode) << " is not supported, using FIFO.\n";
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -431,11 +709,13 @@ void VK::createSwapchain()
 
     // Choose best of these three settings.
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
+    presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapchainSupport.capabilities);
 
     // Specify how many images would have in the swap chain.
     uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
+    if (requestedSwapchainImageCount > 0)
+        imageCount = std::max(requestedSwapchainImageCount, swapchainSupport.capabilities.minImageCount);
     // Check if imageCount exceed supported maximum image count. (0 means no maximum)
     if (swapchainSupport.capabilities.maxImageCount > 0 && imageCount > swapchainSupport.capabilities.maxImageCount)
     {
@@ -463,7 +743,7 @@ void VK::createSwapchain()
                                      before using it in another queue family. This option offers the best performance.
         - VK_SHARING_MODE_CONCURRENT: Images can be used across multiple queue families without explicit ownership transfers.
     */
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    const QueueFamilyIndices& indices = VK::queueFamilyIndices;
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
     if (indices.graphicsFamily != indices.presentFamily)
@@ -499,8 +779,10 @@ void VK::createSwapchain()
         It's possible that your swap chain becomes invalid or unoptimized while your application is running,
         for example because the window was resized. In that case the swap chain actually needs to be recreated
         from scratch and a reference to the old one must be specified in this field.
+        (VK_NULL_HANDLE the first time) The old swapchain is retired, images that were already
+        acquired can still be presented, and the driver may reuse its resources for the new one.
     */
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = swapchain;
 
     // Create swap chain.
     if (vkCreateSwapchainKHR(logicalDevice, &createInfo, nullptr, &swapchain) != VK_SUCCESS)
@@ -512,14 +794,74 @@ void VK::createSwapchain()
 }
 void VK::destroySwapchain()
 {
+    for (VkSemaphore semaphore : renderFinishedSemaphores)
+        vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+    renderFinishedSemaphores.clear();
     vkDestroySwapchainKHR(logicalDevice, swapchain, nullptr);
 }
+void VK::createOffscreenImages()
+{
+    /*
+        Headless mode replaces the swapchain with a small pool of images we own ourselves.
+        They are filled into swapchainImages so image views, framebuffers and command
+        buffers are created exactly the same way as for a window.
+    */
+    swapchainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    swapchainExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+
+    uint32_t imageCount = requestedSwapchainImageCount > 0 ? requestedSwapchainImageCount : OFFSCREEN_IMAGE_COUNT;
+    swapchainImages.resize(imageCount);
+    offscreenImageAllocations.resize(imageCount);
+    offscreenImageIndex = 0;
+
+    for (size_t i = 0; i < swapchainImages.size(); i++)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = swapchainImageFormat;
+        imageInfo.extent = { swapchainExtent.width, swapchainExtent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // Transfer source so rendered frames can be copied out (e.g. for screenshots or comparisons).
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &swapchainImages[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create offscreen image.");
+
+        offscreenImageAllocations[i] = allocator.allocateForImage(swapchainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+void VK::destroyOffscreenImages()
+{
+    for (size_t i = 0; i < swapchainImages.size(); i++)
+    {
+        vkDestroyImage(logicalDevice, swapchainImages[i], nullptr);
+        allocator.free(offscreenImageAllocations[i]);
+    }
+}
 void VK::retrieveSwapchainImages()
 {
     uint32_t imageCount;
     vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, nullptr);
     swapchainImages.resize(imageCount);
     vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, swapchainImages.data());
+
+    /*
+        One per image: the image's present waits on it, and the image is only acquired again
+        once that present is done with it. One per frame slot could be signaled again while
+        the present of an earlier frame still waits on it.
+    */
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    renderFinishedSemaphores.assign(imageCount, VK_NULL_HANDLE);
+    for (VkSemaphore& semaphore : renderFinishedSemaphores)
+        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create synchronization objects for a swapchain image.");
 }
 void VK::createImageViews()
 {
@@ -604,7 +946,8 @@ void VK::createRenderPass()
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: Images to be used as destination for a memory copy operation.
     */
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen images are never presented, leave them ready to be copied out instead.
+    colorAttachment.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     /*
         Subpasses and attachment references.
@@ -658,12 +1001,16 @@ void VK::destroyRenderPass()
 {
     vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
 }
-VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice logicalDevice)
+VkShaderModule createShaderModule(const uint32_t* code, size_t codeSize, VkDevice logicalDevice)
 {
+    // SPIR-V is a stream of 32-bit words.
+    if (codeSize % 4 != 0)
+        throw std::runtime_error("Shader code size is not a multiple of 4.");
+
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); // cast char pointer to uint32_t pointer
+    createInfo.codeSize = codeSize;
+    createInfo.pCode = code;
 
     // Create shader module.
     VkShaderModule shaderModule;
@@ -674,6 +1021,182 @@ VkShaderModule createShaderModule(const std::vector<char>& code, VkDevice logica
 
     return shaderModule;
 }
+// SPIR-V of one shader, embedded or mapped from a file.
+struct ShaderCode
+{
+    FileView file; // Keeps a shader loaded from disk mapped.
+    const uint32_t* code = nullptr;
+    size_t size = 0; // In bytes.
+
+    VkShaderModule createModule(VkDevice logicalDevice) const { return createShaderModule(code, size, logicalDevice); }
+    ShaderReflection reflect() const { return ShaderReflection::reflect(code, size); }
+};
+/*
+    Shaders are compiled into the executable by shader/compile_shaders.py,
+    so creating a pipeline doesn't touch the file system.
+    With VK::shaderDirectory set, a .spv file found there replaces the embedded code,
+    which allows editing shaders without rebuilding.
+*/
+template <size_t N>
+ShaderCode loadShaderCode(const char* filename, const uint32_t (&embeddedCode)[N])
+{
+    ShaderCode shader;
+    if (!VK::shaderDirectory.empty())
+    {
+        std::string path = VK::shaderDirectory + "/" + filename;
+        if (Util::fileExists(path))
+        {
+            shader.file = Util::mapFile(path);
+            shader.code = reinterpret_cast<const uint32_t*>(shader.file.data()); // Mapped files are 4 byte aligned.
+            shader.size = shader.file.size();
+            return shader;
+        }
+    }
+    shader.code = embeddedCode;
+    shader.size = sizeof(embeddedCode);
+    return shader;
+}
+/*
+    The graphics shaders are loaded and reflected once, by createPipelineLayout.
+    createGraphicsPipeline builds its modules from the same code and checks its vertex input
+    against the same reflection, also when the pipeline is recreated.
+*/
+struct GraphicsShaders
+{
+    ShaderCode vert;
+    ShaderCode frag;
+    ShaderReflection vertReflection;
+    ShaderReflection fragReflection;
+};
+GraphicsShaders graphicsShaders;
+// Throws if the push constant range of a stage doesn't have the size of the struct the application pushes.
+void checkPushConstantSize(const CachedPipelineLayout& layout, VkShaderStageFlagBits stage, size_t size)
+{
+    for (const VkPushConstantRange& range : layout.pushConstantRanges)
+    {
+        if ((range.stageFlags & stage) && range.offset == 0 && range.size == size)
+            return;
+    }
+    throw std::runtime_error("Shader push constants don't match the push constants of the application.");
+}
+const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+const uint32_t PIPELINE_CACHE_MAGIC = 0x43505650; // "PVPC"
+const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+/*
+    Header written in front of the data returned by vkGetPipelineCacheData.
+    The cache data is only valid for the exact device and driver that created it,
+    a cache from another GPU or an older driver is thrown away on load.
+*/
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t fileVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+// Returns true if the cache file was created by this device and driver.
+bool isPipelineCacheValid(const FileView& file, const VkPhysicalDeviceProperties& properties)
+{
+    if (file.size() < sizeof(PipelineCacheFileHeader))
+        return false;
+
+    PipelineCacheFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != PIPELINE_CACHE_MAGIC
+        || header.fileVersion != PIPELINE_CACHE_FILE_VERSION
+        || header.vendorID != properties.vendorID
+        || header.deviceID != properties.deviceID
+        || header.driverVersion != properties.driverVersion
+        || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0
+        || header.dataSize != file.size() - sizeof(header))
+        return false;
+
+    // The data starts with Vulkan's own header, check that it agrees too.
+    VkPipelineCacheHeaderVersionOne cacheHeader;
+    if (header.dataSize < sizeof(cacheHeader))
+        return false;
+    memcpy(&cacheHeader, file.data() + sizeof(header), sizeof(cacheHeader));
+    return cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && cacheHeader.vendorID == properties.vendorID
+        && cacheHeader.deviceID == properties.deviceID
+        && memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+void VK::createPipelineCache()
+{
+    /*
+        Pipeline cache.
+        Creating a pipeline compiles its shaders into GPU code, which is slow.
+        A pipeline cache keeps the results, and saving it to disk lets the
+        next launch skip the compilation of pipelines it has seen before.
+    */
+    const VkPhysicalDeviceProperties& properties = deviceCapabilities.properties;
+
+    FileView file;
+    if (Util::fileExists(PIPELINE_CACHE_FILE))
+    {
+        file = Util::mapFile(PIPELINE_CACHE_FILE);
+        if (!isPipelineCacheValid(file, properties))
+        {
+            std::cout << "Ignoring pipeline cache from another device or driver.\n";
+            file = FileView();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (!file.empty())
+    {
+        cacheInfo.initialDataSize = file.size() - sizeof(PipelineCacheFileHeader);
+        cacheInfo.pInitialData = file.data() + sizeof(PipelineCacheFileHeader);
+    }
+
+    if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline cache.");
+}
+void VK::destroyPipelineCache()
+{
+    // Save the cache so the next launch can skip pipeline compilation.
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, nullptr) == VK_SUCCESS && dataSize > 0)
+    {
+        const VkPhysicalDeviceProperties& properties = deviceCapabilities.properties;
+
+        // The header is written as raw bytes, zero the padding in front of dataSize too.
+        PipelineCacheFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.fileVersion = PIPELINE_CACHE_FILE_VERSION;
+        header.vendorID = properties.vendorID;
+        header.deviceID = properties.deviceID;
+        header.driverVersion = properties.driverVersion;
+        memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+        std::vector<char> file(sizeof(header) + dataSize);
+        if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, file.data() + sizeof(header)) == VK_SUCCESS)
+        {
+            header.dataSize = dataSize;
+            file.resize(sizeof(header) + dataSize);
+            memcpy(file.data(), &header, sizeof(header));
+
+            try
+            {
+                Util::writeFileAtomic(PIPELINE_CACHE_FILE, file);
+            }
+            catch (const std::exception& e)
+            {
+                // Not being able to save the cache only costs startup time next launch.
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+
+    vkDestroyPipelineCache(logicalDevice, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+}
 void VK::createPipelineLayout()
 {
     /*
@@ -685,37 +1208,44 @@ void VK::createPipelineLayout()
         in the fragment shader.
 
         These uniform values need to be specified during pipeline creation by creating
-        a VkPipelineLayout object. Even though we won't be using them until a future chapter,
-        we are still required to create an empty pipeline layout.
+        a VkPipelineLayout object.
 
-        Create a class member to hold this object, because we'll refer to it from other
-        functions at a later point in time:
+        Instead of describing the layout by hand, it is reflected from the SPIR-V of the shaders:
+        their descriptor bindings and push constant blocks become the set layouts and push constant
+        ranges. The cache hands out the same layout for shaders with the same interface,
+        and owns it until cleanup.
     */
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-    // Create pipeline layout.
-    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create render pass.");
+    GraphicsShaders& shaders = graphicsShaders;
+    shaders.vert = loadShaderCode("vert.spv", EmbeddedShaders::vert);
+    shaders.frag = loadShaderCode("frag.spv", EmbeddedShaders::frag);
+    shaders.vertReflection = shaders.vert.reflect();
+    shaders.fragReflection = shaders.frag.reflect();
+
+    /*
+        SPIR-V doesn't say whether a uniform buffer is bound at a dynamic offset, that is up to
+        the application. Ours all live in the uniform ring buffer, so they are all dynamic.
+    */
+    ShaderReflection& vertReflection = shaders.vertReflection;
+    for (ShaderDescriptorBinding& binding : vertReflection.descriptorBindings)
+    {
+        if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     }
-}
-void VK::destroyPipelineLayout()
-{
-    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+    const CachedPipelineLayout& layout = pipelineLayoutCache.getPipelineLayout({ vertReflection, shaders.fragReflection });
+
+    // The vertex shader reads the position decoding of the vertex format as push constants.
+    checkPushConstantSize(layout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(VertexPushConstants));
+    if (layout.setLayouts.size() != 1 || vertReflection.descriptorBindings.size() != 2)
+        throw std::runtime_error("Vertex shader doesn't bind the frame and object uniforms in set 0.");
+    pipelineLayout = layout.layout;
+    uniformDescriptorSetLayout = layout.setLayouts[0];
 }
 void VK::createGraphicsPipeline()
 {
-    // Read shader file.
-    auto vertShaderCode = Util::readFile("shader/vert.spv");
-    auto fragShaderCode = Util::readFile("shader/frag.spv");
-
-    // Create shader module with shader code.
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, logicalDevice);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, logicalDevice);
+    // Create shader modules with the code loaded by createPipelineLayout.
+    const GraphicsShaders& shaders = graphicsShaders;
+    VkShaderModule vertShaderModule = shaders.vert.createModule(logicalDevice);
+    VkShaderModule fragShaderModule = shaders.frag.createModule(logicalDevice);
 
     /*
         Shader stage create info.
@@ -747,14 +1277,14 @@ void VK::createGraphicsPipeline()
         - Attribute descriptions: type of the attributes passed to the vertex shader,
                     which binding to load them from and at which offset.
     */
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    // The layouts are generated at compile time from the vertex types, see vertex_layout.h.
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = VertexInputLayout::inputState;
+    if (activeVertexFormat == VertexFormat::Half)
+        vertexInputInfo = HalfVertexInputLayout::inputState;
+    else if (activeVertexFormat == VertexFormat::Snorm16)
+        vertexInputInfo = Snorm16VertexInputLayout::inputState;
+    // Every input of the vertex shader must be fed by an attribute of a matching type.
+    shaders.vertReflection.validateVertexInput(vertexInputInfo);
 
     /*
         Input assembly state create info.
@@ -773,43 +1303,24 @@ void VK::createGraphicsPipeline()
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    /*
-        Viewport:
-        A viewport describes the region of the framebuffer that the output will be rendered to.
-    */
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapchainExtent.width;
-    viewport.height = (float)swapchainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    /*
-        Scissor:
-        While viewports define the transformation from the image to the framebuffer,
-        scissor rectangles define in which regions pixels will actually be stored.
-        Any pixels outside the scissor rectangles will be discarded by the rasterizer.
-        They function like a filter rather than a transformation.
-    */
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapchainExtent;
-
     /*
        Viewport state create info.
-       Now this viewport and scissor rectangle need to be combined into
-       a viewport state using the VkPipelineViewportStateCreateInfo struct.
+       A viewport describes the region of the framebuffer that the output will be rendered to,
+       scissor rectangles define in which regions pixels will actually be stored.
        It is possible to use multiple viewports and scissor rectangles on
        some graphics cards, so its members reference an array of them.
        Using multiple requires enabling a GPU feature.
+
+       Both are dynamic state (see below) and set in the command buffer, so the
+       pipeline doesn't depend on the swapchain size and survives window resizes.
+       Only the counts are needed here.
     */
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
 
     /*
         Rasterization state create info.
@@ -886,7 +1397,7 @@ void VK::createGraphicsPipeline()
     */
     VkDynamicState dynamicStates[] = {
         VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_LINE_WIDTH
+        VK_DYNAMIC_STATE_SCISSOR
     };
 
     VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -909,7 +1420,7 @@ void VK::createGraphicsPipeline()
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pDepthStencilState = nullptr; // Optional
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
 
     pipelineInfo.layout = pipelineLayout;
     pipelineInfo.renderPass = renderPass;
@@ -919,7 +1430,7 @@ void VK::createGraphicsPipeline()
     pipelineInfo.basePipelineIndex = -1; // Optional
 
     // Create graphics pipeline.
-    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
@@ -956,10 +1467,6 @@ void VK::createFramebuffers()
             throw std::runtime_error("Failed to create framebuffer.");
     }
 }
-void VK::freeCommandBuffers()
-{
-    vkFreeCommandBuffers(logicalDevice, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-}
 void VK::destroyFramebuffers()
 {
     for (auto framebuffer : swapchainFramebuffers)
@@ -969,8 +1476,6 @@ void VK::destroyFramebuffers()
 }
 void VK::createCommandPool()
 {
-    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
-
     /*
         Command pool create info.
         Command buffers are executed by submitting them on one of the device queues,
@@ -987,205 +1492,1407 @@ void VK::createCommandPool()
     */
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0; // Optional
+    poolInfo.queueFamilyIndex = graphicsQueueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // The upload command buffer is re-recorded for every flush.
 
     // Create command pool.
     if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command pool.");
     }
+
+    // Upload command buffers are submitted to the transfer queue, they come from a pool of its family.
+    transferCommandPool = commandPool;
+    if (dedicatedTransferQueue)
+    {
+        poolInfo.queueFamilyIndex = transferQueueFamily;
+        if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create command pool.");
+    }
 }
 void VK::destroyCommandPool()
 {
+    if (transferCommandPool != commandPool)
+        vkDestroyCommandPool(logicalDevice, transferCommandPool, nullptr);
+    transferCommandPool = VK_NULL_HANDLE;
     vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 }
-void VK::allocateCommandBuffers()
+void VK::createQueryPools()
 {
-    commandBuffers.resize(swapchainFramebuffers.size());
-
     /*
-        Command buffers are allocated with the vkAllocateCommandBuffers function,
-        which takes a VkCommandBufferAllocateInfo struct as parameter that specifies
-        the command pool and number of buffers to allocate.
+        Timestamps can only be written on queues with timestampValidBits > 0,
+        and a tick lasts timestampPeriod nanoseconds.
     */
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-    // Create command buffers.
-    if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate command buffers.");
+    uint32_t validBits = deviceCapabilities.queueFamilies[graphicsQueueFamily].timestampValidBits;
+    timestampPeriod = deviceCapabilities.properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? UINT64_MAX : (1ULL << validBits) - 1;
+    timestampsSupported = validBits > 0;
 
     /*
-        Starting command buffer recording.
-
-        We begin recording a command buffer by calling vkBeginCommandBuffer with
-        a small VkCommandBufferBeginInfo structure as argument that specifies some
-        details about the usage of this specific command buffer.
+        Every frame in flight gets its own query slots, they are read back
+        after its fence has signaled and reset inside its next command buffer.
     */
-    for (size_t i = 0; i < commandBuffers.size(); i++)
+    uint32_t frameCount = framesInFlight;
+    queryResultsPending.assign(frameCount, false);
+
+    if (timestampsSupported)
     {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;
-        beginInfo.pInheritanceInfo = nullptr;
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = frameCount * 2;
+        if (vkCreateQueryPool(logicalDevice, &poolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timestamp query pool.");
+    }
 
-        if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("Failed to begin recording command buffer.");
+    if (pipelineStatisticsSupported)
+    {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = frameCount;
+        // Results are returned in bit order: vertex invocations, then fragment invocations.
+        poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        if (vkCreateQueryPool(logicalDevice, &poolInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline statistics query pool.");
     }
 }
-void VK::beginRenderPass()
+void VK::destroyQueryPools()
 {
-    for (size_t i = 0; i < commandBuffers.size(); i++)
-    {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapchainFramebuffers[i];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = swapchainExtent;
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(logicalDevice, timestampQueryPool, nullptr);
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(logicalDevice, statisticsQueryPool, nullptr);
+    timestampQueryPool = VK_NULL_HANDLE;
+    statisticsQueryPool = VK_NULL_HANDLE;
+}
+/*
+    Writes one timestamp while the graphics queue is otherwise idle and notes the CPU time
+    around the submit. The timestamp lands somewhere between the submit and the wait returning,
+    taking the middle keeps the error below half of that round trip.
+*/
+void VK::calibrateTimestamps()
+{
+    if (timestampQueryPool == VK_NULL_HANDLE)
+        return;
 
-        VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate command buffer.");
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording command buffer.");
+    // Borrows the first frame's queries, its command buffer resets them before use.
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 0);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end command buffer.");
 
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    vkQueueWaitIdle(graphicsQueue); // Startup uploads would delay the timestamp.
+    auto submitTime = std::chrono::steady_clock::now();
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit command buffer.");
+    vkQueueWaitIdle(graphicsQueue);
+    auto completeTime = std::chrono::steady_clock::now();
 
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkGetQueryPoolResults(logicalDevice, timestampQueryPool, 0, 1, sizeof(timestampCalibrationTicks), &timestampCalibrationTicks,
+        sizeof(timestampCalibrationTicks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    timestampCalibrationTime = submitTime + (completeTime - submitTime) / 2;
+    vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+}
+void VK::readQueryResults(uint32_t frame)
+{
+    if (!queryResultsPending[frame])
+        return;
 
-        VkBuffer vertexBuffers[] = { vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+    /*
+        Only called once the fence of the frame that used these queries has signaled,
+        so the results are available and this never blocks. (no VK_QUERY_RESULT_WAIT_BIT)
+        With VK_QUERY_RESULT_WITH_AVAILABILITY_BIT every query is followed by its availability value.
+    */
+    bool available = true;
+    GpuFrameStats stats;
 
-        vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+    if (timestampQueryPool != VK_NULL_HANDLE)
+    {
+        uint64_t results[4] = {}; // begin, begin available, end, end available
+        vkGetQueryPoolResults(logicalDevice, timestampQueryPool, frame * 2, 2, sizeof(results), results,
+            sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        available = available && results[1] != 0 && results[3] != 0;
+        uint64_t ticks = (results[2] - results[0]) & timestampMask;
+        stats.gpuTime = ticks * static_cast<double>(timestampPeriod) / 1e6;
+
+        // The input time converted to GPU ticks, the masked difference stays right across a wrap of the counter.
+        double inputNs = std::chrono::duration<double, std::nano>(frameInputTimes[frame] - timestampCalibrationTime).count();
+        uint64_t inputTicks = timestampCalibrationTicks + static_cast<uint64_t>(static_cast<int64_t>(inputNs / timestampPeriod));
+        stats.latency = ((results[2] - inputTicks) & timestampMask) * static_cast<double>(timestampPeriod) / 1e6;
+    }
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+    {
+        uint64_t results[3] = {}; // vertex invocations, fragment invocations, available
+        vkGetQueryPoolResults(logicalDevice, statisticsQueryPool, frame, 1, sizeof(results), results,
+            sizeof(results), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        available = available && results[2] != 0;
+        stats.vertexInvocations = results[0];
+        stats.fragmentInvocations = results[1];
+    }
 
-        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to end command buffer.");
-        }
+    if (available)
+    {
+        stats.available = true;
+        gpuFrameStats = stats;
+        queryResultsPending[frame] = false;
     }
 }
-void VK::createSyncObjects()
+void VK::createCullingPipeline()
 {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(swapchainImages.size(), VK_NULL_HANDLE);
-
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    /*
+        With asyncCompute the dispatches are recorded in their own command buffers and submitted
+        to the compute-only family, otherwise they are recorded in the graphics command buffers.
+        computeQueueFamily is the family either way.
+    */
+    if (!(deviceCapabilities.queueFamilies[computeQueueFamily].queueFlags & VK_QUEUE_COMPUTE_BIT))
+        throw std::runtime_error("GPU culling requires a queue that supports compute.");
+
+    // Set 0, binding 0: all instances, 1: visible instances, 2: indirect draw command. (reflected from the shader)
+    ShaderCode cullShader = loadShaderCode("cull.spv", EmbeddedShaders::cull);
+    ShaderReflection reflection = cullShader.reflect();
+    const CachedPipelineLayout& layout = pipelineLayoutCache.getPipelineLayout({ reflection });
+    checkPushConstantSize(layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullingPushConstants));
+    if (layout.setLayouts.size() != 1 || reflection.descriptorBindings.size() != 3)
+        throw std::runtime_error("Culling shader doesn't bind the three buffers in set 0.");
+    cullPipelineLayout = layout.layout;
+    cullDescriptorSetLayout = layout.setLayouts[0];
+
+    VkShaderModule cullShaderModule = cullShader.createModule(logicalDevice);
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+    if (vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute pipeline.");
+    vkDestroyShaderModule(logicalDevice, cullShaderModule, nullptr);
+
+    // One descriptor set per frame in flight, a set can't be updated while a submitted frame uses it.
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const ShaderDescriptorBinding& binding : reflection.descriptorBindings)
+    {
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = binding.descriptorType;
+        poolSize.descriptorCount = binding.descriptorCount * framesInFlight;
+        poolSizes.push_back(poolSize);
+    }
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = framesInFlight;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &cullDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> setLayouts(framesInFlight, cullDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = cullDescriptorPool;
+    allocInfo.descriptorSetCount = framesInFlight;
+    allocInfo.pSetLayouts = setLayouts.data();
+    cullDescriptorSets.resize(framesInFlight);
+    if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate descriptor sets.");
+    cullDescriptorSetVersions.assign(framesInFlight, UINT64_MAX); // Written when first used.
+
+    indirectBuffers.assign(framesInFlight, VK_NULL_HANDLE);
+    indirectBufferAllocations.assign(framesInFlight, Allocation());
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        createBuffer(sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffers[i], indirectBufferAllocations[i],
+            { graphicsQueueFamily, computeQueueFamily });
+}
+void VK::destroyCullingPipeline()
+{
+    if (cullPipeline == VK_NULL_HANDLE)
+        return;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create synchronization objects for a frame.");
+    for (uint32_t i = 0; i < indirectBuffers.size(); i++)
+        destroyBuffer(indirectBuffers[i], indirectBufferAllocations[i]);
+    indirectBuffers.clear();
+    indirectBufferAllocations.clear();
+    // Destroying the pool frees its descriptor sets.
+    vkDestroyDescriptorPool(logicalDevice, cullDescriptorPool, nullptr);
+    vkDestroyPipeline(logicalDevice, cullPipeline, nullptr);
+    // The layouts belong to the pipeline layout cache.
+    cullPipelineLayout = VK_NULL_HANDLE;
+    cullDescriptorSetLayout = VK_NULL_HANDLE;
+    cullDescriptorSets.clear();
+    cullPipeline = VK_NULL_HANDLE;
 }
-void VK::destroySyncObjects()
+/*
+    Maps area, in normalized device coordinates, onto the plane the instances are placed in.
+    The instances have no z, so clipFromInstance restricted to that plane is a 2D homography
+    whose inverse takes the area's corners back onto the plane. Returns the bounding rectangle
+    of the mapped corners, or an unbounded one if part of the area doesn't meet the plane in
+    front of the viewer.
+*/
+glm::vec4 cullingAreaOnInstancePlane(const glm::vec4& area, const glm::mat4& clipFromInstance)
 {
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(logicalDevice, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(logicalDevice, inFlightFences[i], nullptr);
+    const float infinity = std::numeric_limits<float>::infinity();
+    const glm::vec4 unbounded(-infinity, -infinity, infinity, infinity);
+
+    // Maps (x, y, 1) on the plane to clip x, y and w: columns and rows x, y and w of clipFromInstance.
+    glm::mat3 planeToClip(
+        glm::vec3(clipFromInstance[0].x, clipFromInstance[0].y, clipFromInstance[0].w),
+        glm::vec3(clipFromInstance[1].x, clipFromInstance[1].y, clipFromInstance[1].w),
+        glm::vec3(clipFromInstance[3].x, clipFromInstance[3].y, clipFromInstance[3].w));
+    if (glm::determinant(planeToClip) == 0.0f)
+        return unbounded; // The plane is seen edge on.
+    glm::mat3 clipToPlane = glm::inverse(planeToClip);
+
+    glm::vec4 bounds(infinity, infinity, -infinity, -infinity);
+    glm::vec2 corners[] = { { area.x, area.y }, { area.z, area.y }, { area.x, area.w }, { area.z, area.w } };
+    for (const glm::vec2& corner : corners)
+    {
+        glm::vec3 point = clipToPlane * glm::vec3(corner.x, corner.y, 1.0f);
+        // The plane point has clip w = 1 / point.z, it is behind the viewer unless that is positive.
+        if (point.z <= 0.0f)
+            return unbounded;
+        bounds.x = std::min(bounds.x, point.x / point.z);
+        bounds.y = std::min(bounds.y, point.y / point.z);
+        bounds.z = std::max(bounds.z, point.x / point.z);
+        bounds.w = std::max(bounds.w, point.y / point.z);
     }
+    return bounds;
 }
+void VK::recordCulling(VkCommandBuffer commandBuffer)
+{
+    // Point the frame's descriptor set at the current buffers, it is not in use since the frame's fence signaled.
+    VkDescriptorSet descriptorSet = cullDescriptorSets[currentFrame];
+    VkBuffer indirectBuffer = indirectBuffers[currentFrame];
+    if (cullDescriptorSetVersions[currentFrame] != instanceBufferVersion)
+    {
+        VkDescriptorBufferInfo bufferInfos[3] = {
+            { instanceBuffer, 0, VK_WHOLE_SIZE },
+            { visibleInstanceBuffers[currentFrame], 0, VK_WHOLE_SIZE },
+            { indirectBuffer, 0, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[3]{};
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(logicalDevice, 3, writes, 0, nullptr);
+        cullDescriptorSetVersions[currentFrame] = instanceBufferVersion;
+    }
 
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(VK::physicalDevice, &memProperties);
+    /*
+        No barrier against earlier draws: the frame's copies were last read by the frame
+        that used this frame slot before, which has completed.
+    */
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-        if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-            return i;
+    // Start with no visible instances, the shader counts them up.
+    VkDrawIndexedIndirectCommand drawCommand{};
+    drawCommand.indexCount = indexCount;
+    drawCommand.instanceCount = 0;
+    vkCmdUpdateBuffer(commandBuffer, indirectBuffer, 0, sizeof(drawCommand), &drawCommand);
 
-    throw std::runtime_error("Failed to find suitable memory type.");
-}
-void VK::createVertexBuffer()
-{
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = sizeof(vertices[0]) * vertices.size();
-    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create vertex buffer.");
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(logicalDevice, vertexBuffer, &memRequirements);
+    /*
+        The shader tests the instances before drawTransforms and viewProjection. One culled list
+        serves every draw call, so it keeps what any of them shows: the union of cullingFrustum
+        mapped back through each draw's transforms.
+    */
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec4 frustum(infinity, infinity, -infinity, -infinity);
+    uint32_t transformedDraws = std::min<uint32_t>(drawCallCount, static_cast<uint32_t>(drawTransforms.size()));
+    for (uint32_t i = 0; i <= transformedDraws && i < drawCallCount; i++)
+    {
+        // Draws past drawTransforms share the identity, one of them is enough.
+        glm::mat4 model = i < transformedDraws ? drawTransforms[i] : glm::mat4(1.0f);
+        glm::vec4 area = cullingAreaOnInstancePlane(cullingFrustum, viewProjection * model);
+        frustum = glm::vec4(std::min(frustum.x, area.x), std::min(frustum.y, area.y),
+            std::max(frustum.z, area.z), std::max(frustum.w, area.w));
+    }
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    if (vkAllocateMemory(logicalDevice, &allocInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    CullingPushConstants pushConstants{};
+    pushConstants.frustum = frustum;
+    pushConstants.instanceCount = instanceCount;
+    pushConstants.meshRadius = meshRadius;
 
-    vkBindBufferMemory(logicalDevice, vertexBuffer, vertexBufferMemory, 0);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, 1, 1); // local_size_x = 64
 
-    void* data;
-    vkMapMemory(logicalDevice, vertexBufferMemory, 0, bufferInfo.size, 0, &data);
-    memcpy(data, vertices.data(), (size_t)bufferInfo.size);
-    vkUnmapMemory(logicalDevice, vertexBufferMemory);
+    // The draws read the command and the visible instances written by the shader. (or wait for cullFinishedSemaphores)
+    if (asyncCompute)
+        return;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
-void VK::destroyVertexBuffer()
+void VK::createFrameCommands()
 {
-    vkDestroyBuffer(logicalDevice, vertexBuffer, nullptr);
-    vkFreeMemory(logicalDevice, vertexBufferMemory, nullptr);
-}
+    /*
+        Command pools are created per frame in flight with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        their command buffers only live for one frame. Instead of resetting every command buffer,
+        the whole pool is reset with vkResetCommandPool once the frame's fence has signaled.
+    */
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = graphicsQueueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-void VK::render()
-{
-    vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    // vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
+    // One secondary command buffer per recording thread, at least one recorded on the main thread.
+    uint32_t secondaryCount = recordingThreads.getThreadCount() > 0 ? recordingThreads.getThreadCount() : 1;
 
-    // Acquiring an image from the swap chain.
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(logicalDevice, swapchain, UINT64_MAX,
-        imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    frameCommands.resize(framesInFlight);
+    for (auto& frame : frameCommands)
     {
-        recreateSwapchain();
-        return;
-    }
-    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-        throw std::runtime_error("Failed to acquire swapchain image.");
-
-    // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
-        vkWaitForFences(logicalDevice, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-    // Mark the image as now being in use by this frame
-    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-
-    // Reset fence before using it.
-    vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
+        if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create command pool.");
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate command buffers.");
+
+        frame.secondaryCommandPools.resize(secondaryCount);
+        frame.secondaryCommandBuffers.resize(secondaryCount);
+        for (uint32_t i = 0; i < secondaryCount; i++)
+        {
+            if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &frame.secondaryCommandPools[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create command pool.");
 
-    // Submitting the command buffer.
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            allocInfo.commandPool = frame.secondaryCommandPools[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &frame.secondaryCommandBuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate command buffers.");
+        }
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+        if (asyncCompute)
+        {
+            VkCommandPoolCreateInfo computePoolInfo = poolInfo;
+            computePoolInfo.queueFamilyIndex = computeQueueFamily;
+            if (vkCreateCommandPool(logicalDevice, &computePoolInfo, nullptr, &frame.computeCommandPool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create command pool.");
+
+            allocInfo.commandPool = frame.computeCommandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &frame.computeCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate command buffers.");
+        }
+    }
+}
+void VK::destroyFrameCommands()
+{
+    // Destroying a pool frees its command buffers.
+    for (auto& frame : frameCommands)
+    {
+        for (auto pool : frame.secondaryCommandPools)
+            vkDestroyCommandPool(logicalDevice, pool, nullptr);
+        vkDestroyCommandPool(logicalDevice, frame.commandPool, nullptr);
+        if (frame.computeCommandPool != VK_NULL_HANDLE)
+            vkDestroyCommandPool(logicalDevice, frame.computeCommandPool, nullptr);
+    }
+    frameCommands.clear();
+}
+/*
+    Records the command buffers of the current frame in flight, drawing into swapchain image imageIndex.
+    Only called once the frame's fence has signaled, so none of its command buffers are still executing.
+*/
+void VK::recordCommandBuffer(uint32_t imageIndex)
+{
+    FrameCommands& frame = frameCommands[currentFrame];
+    VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+    // Split the draws and particles evenly, but don't bother the worker threads for a few of them.
+    uint32_t secondaryCount = static_cast<uint32_t>(frame.secondaryCommandBuffers.size());
+    uint32_t maxSecondaryCount = std::max((drawCallCount + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY,
+        (particleCount + MIN_PARTICLES_PER_SECONDARY - 1) / MIN_PARTICLES_PER_SECONDARY);
+    secondaryCount = std::max(1u, std::min(secondaryCount, maxSecondaryCount));
+
+    recordingThreads.run(secondaryCount, [&](uint32_t index) {
+        vkResetCommandPool(logicalDevice, frame.secondaryCommandPools[index], 0);
+        uint32_t firstDraw = static_cast<uint32_t>(uint64_t(drawCallCount) * index / secondaryCount);
+        uint32_t endDraw = static_cast<uint32_t>(uint64_t(drawCallCount) * (index + 1) / secondaryCount);
+        uint32_t firstParticle = static_cast<uint32_t>(uint64_t(particleCount) * index / secondaryCount);
+        uint32_t endParticle = static_cast<uint32_t>(uint64_t(particleCount) * (index + 1) / secondaryCount);
+        recordDraws(frame.secondaryCommandBuffers[index], imageIndex, firstDraw, endDraw - firstDraw,
+            firstParticle, endParticle - firstParticle);
+    });
+
+    vkResetCommandPool(logicalDevice, frame.commandPool, 0);
+
+    /*
+        Starting command buffer recording.
+
+        We begin recording a command buffer by calling vkBeginCommandBuffer with
+        a small VkCommandBufferBeginInfo structure as argument that specifies some
+        details about the usage of this specific command buffer.
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: it is recorded again before the next submission.
+    */
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording command buffer.");
+
+    uint32_t query = static_cast<uint32_t>(currentFrame);
+
+    // Culling runs before the render pass, compute dispatches are not allowed inside one.
+    if (gpuCulling && !asyncCompute)
+        recordCulling(commandBuffer);
+    if (asyncCompute)
+    {
+        vkResetCommandPool(logicalDevice, frame.computeCommandPool, 0);
+        if (vkBeginCommandBuffer(frame.computeCommandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("Failed to begin recording command buffer.");
+        recordCulling(frame.computeCommandBuffer);
+        if (vkEndCommandBuffer(frame.computeCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to end command buffer.");
+    }
+
+    /*
+        Queries have to be reset before they are reused, outside of the render pass.
+        Note that in windowed mode the first timestamp can be written before the
+        image is acquired (the semaphore only blocks color output), so GPU time
+        also contains waiting for the presentation engine.
+    */
+    if (timestampQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, query * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, query * 2);
+    }
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, query, 1);
+        vkCmdBeginQuery(commandBuffer, statisticsQueryPool, query, 0);
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = swapchainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = swapchainExtent;
+
+    VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+
+    // The contents of the subpass come from the secondary command buffers only.
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, secondaryCount, frame.secondaryCommandBuffers.data());
+    vkCmdEndRenderPass(commandBuffer);
+
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+        vkCmdEndQuery(commandBuffer, statisticsQueryPool, query);
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, query * 2 + 1);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end command buffer.");
+}
+/*
+    Records draws [firstDraw, firstDraw + drawCount) and particles [firstParticle, firstParticle + particleDrawCount)
+    into a secondary command buffer. Called from worker threads.
+*/
+void VK::recordDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t firstDraw, uint32_t drawCount,
+    uint32_t firstParticle, uint32_t particleDrawCount)
+{
+    /*
+        Secondary command buffers executed inside a render pass need to know the render pass
+        (and optionally the framebuffer) they continue. Pipeline statistics queries active in the
+        primary command buffer must be declared as well.
+    */
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapchainFramebuffers[imageIndex];
+    if (statisticsQueryPool != VK_NULL_HANDLE)
+        inheritanceInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording command buffer.");
+
+    // State is not inherited from the primary command buffer, every secondary sets its own.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+    // Viewport and scissor are dynamic state, they cover the whole framebuffer.
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapchainExtent.width;
+    viewport.height = (float)swapchainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = swapchainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // With GPU culling only the visible instances are drawn, their number comes from the indirect command.
+    VkBuffer vertexBuffers[] = { vertexBuffer, gpuCulling ? visibleInstanceBuffers[currentFrame] : instanceBuffer };
+    VkDeviceSize offsets[] = { 0, 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vertexPushConstants), &vertexPushConstants);
+
+    for (uint32_t i = 0; i < drawCount; i++)
+    {
+        // Dynamic offsets in binding order: the frame's uniforms, then the object uniforms of this draw.
+        uint32_t dynamicOffsets[] = { frameUniformOffset, objectUniformOffset + (firstDraw + i) * objectUniformStride };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+            &uniformDescriptorSet, 2, dynamicOffsets);
+
+        if (gpuCulling)
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[currentFrame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+        else
+            vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+    }
+
+    if (particleDrawCount > 0)
+        recordParticles(commandBuffer, firstParticle, particleDrawCount);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end command buffer.");
+}
+// Particles circle the center at different radii and speeds, standing in for a CPU particle system.
+void generateParticles(InstanceData* particles, uint32_t firstParticle, uint32_t count, uint64_t frame)
+{
+    float time = frame / 60.0f;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t index = firstParticle + i;
+        uint32_t hash = index * 2654435761u; // Knuth's multiplicative hash, spreads consecutive indices.
+        float radius = 0.05f + 0.9f * (hash >> 8) / float(1 << 24);
+        float angle = index * 2.39996323f + time * 0.2f / radius; // Golden angle apart, inner ones faster.
+
+        // Written field by field in order, the memory may be write combined.
+        InstanceData& particle = particles[i];
+        particle.offset = glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+        particle.scale = glm::vec2(0.01f);
+        particle.color = 0xff000000u | (hash & 0x00ffffffu);
+    }
+}
+/*
+    Appends the particles to the vertex stream and draws them as instances of the mesh.
+    Every recording thread allocates its own range, the allocations of one frame are
+    contiguous and flushed together in render().
+*/
+void VK::recordParticles(VkCommandBuffer commandBuffer, uint32_t firstParticle, uint32_t count)
+{
+    RingAllocation allocation;
+    if (!vertexStream.allocate(VkDeviceSize(sizeof(InstanceData)) * count, allocation))
+        return; // Counted as an overflow in the stream's stats, the particles are skipped this frame.
+    generateParticles(static_cast<InstanceData*>(allocation.data), firstParticle, count, frameNumber + 1);
+
+    // Particles are not transformed per draw, they use the identity slot behind the draw calls.
+    uint32_t dynamicOffsets[] = { frameUniformOffset, objectUniformOffset + drawCallCount * objectUniformStride };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+        &uniformDescriptorSet, 2, dynamicOffsets);
+
+    // The mesh stays bound to binding 0, the instances come from the stream.
+    VkBuffer buffer = vertexStream.getBuffer();
+    vkCmdBindVertexBuffers(commandBuffer, 1, 1, &buffer, &allocation.offset);
+    vkCmdDrawIndexed(commandBuffer, indexCount, count, 0, 0, 0);
+}
+void VK::createUniformRing()
+{
+    /*
+        Dynamic offsets must be multiples of minUniformBufferOffsetAlignment (up to 256 bytes),
+        so every draw's 64 byte matrix takes a slot of that size.
+    */
+    VkDeviceSize alignment = deviceCapabilities.properties.limits.minUniformBufferOffsetAlignment;
+    objectUniformStride = static_cast<uint32_t>(RingBuffer::alignUp(sizeof(ObjectUniforms), alignment));
+    VkDeviceSize frameSize = RingBuffer::alignUp(sizeof(FrameUniforms), alignment) + VkDeviceSize(objectUniformStride) * (drawCallCount + 1);
+    uniformRingDrawCalls = drawCallCount;
+    uniformRing.create(logicalDevice, allocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameSize, framesInFlight, alignment);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &uniformDescriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create descriptor pool.");
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = uniformDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &uniformDescriptorSetLayout;
+    if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &uniformDescriptorSet) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate descriptor sets.");
+
+    /*
+        Both bindings cover one struct at the start of the ring, the dynamic offsets move them
+        to the data of a frame and a draw. One set serves every frame in flight.
+    */
+    VkDescriptorBufferInfo bufferInfos[2] = {
+        { uniformRing.getBuffer(), 0, sizeof(FrameUniforms) },
+        { uniformRing.getBuffer(), 0, sizeof(ObjectUniforms) },
+    };
+    VkWriteDescriptorSet writes[2]{};
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = uniformDescriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(logicalDevice, 2, writes, 0, nullptr);
+}
+void VK::destroyUniformRing()
+{
+    // Destroying the pool frees its descriptor set.
+    if (uniformDescriptorPool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(logicalDevice, uniformDescriptorPool, nullptr);
+    uniformDescriptorPool = VK_NULL_HANDLE;
+    uniformDescriptorSet = VK_NULL_HANDLE;
+    uniformRing.destroy();
+}
+// Writes the transforms of the current frame into its part of the uniform ring. The frame's previous use has completed.
+void VK::writeUniforms()
+{
+    /*
+        drawCallCount changed since the ring was sized. Frames in flight may still read the old ring
+        and its descriptor set, so they are retired and this frame is recorded with a new ring.
+    */
+    if (drawCallCount != uniformRingDrawCalls)
+    {
+        VkBuffer buffer;
+        Allocation allocation;
+        uniformRing.release(buffer, allocation);
+        destroyDeferred(VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer, allocation);
+        // Destroying the pool frees its descriptor set.
+        destroyDeferred(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)uniformDescriptorPool);
+        uniformDescriptorPool = VK_NULL_HANDLE;
+        uniformDescriptorSet = VK_NULL_HANDLE;
+        createUniformRing();
+    }
+
+    RingAllocation frameAllocation;
+    RingAllocation objectAllocation;
+    uniformRing.beginFrame(static_cast<uint32_t>(currentFrame));
+    VkDeviceSize objectBytes = VkDeviceSize(objectUniformStride) * (drawCallCount + 1);
+    if (!uniformRing.allocate(sizeof(FrameUniforms), frameAllocation) || !uniformRing.allocate(objectBytes, objectAllocation))
+        throw std::runtime_error("Uniform ring is too small for the frame's uniforms.");
+
+    // One sequential stream of writes, the memory may be write combined and is never read back.
+    FrameUniforms frameUniforms{ viewProjection };
+    memcpy(frameAllocation.data, &frameUniforms, sizeof(frameUniforms));
+    char* objectData = static_cast<char*>(objectAllocation.data);
+    for (uint32_t i = 0; i <= drawCallCount; i++)
+    {
+        bool transformed = i < drawCallCount && i < drawTransforms.size();
+        ObjectUniforms objectUniforms{ transformed ? drawTransforms[i] : glm::mat4(1.0f) };
+        memcpy(objectData + VkDeviceSize(objectUniformStride) * i, &objectUniforms, sizeof(objectUniforms));
+    }
+
+    frameUniformOffset = static_cast<uint32_t>(frameAllocation.offset);
+    objectUniformOffset = static_cast<uint32_t>(objectAllocation.offset);
+}
+void VK::createSyncObjects()
+{
+    imageAvailableSemaphores.resize(framesInFlight);
+    inFlightFences.assign(timelineSemaphoresEnabled ? 0 : framesInFlight, VK_NULL_HANDLE);
+    imageFrameNumbers.assign(swapchainImages.size(), 0);
+    frameSlotNumbers.assign(framesInFlight, 0);
+    frameInputTimes.assign(framesInFlight, std::chrono::steady_clock::time_point());
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create synchronization objects for a frame.");
+    for (VkFence& fence : inFlightFences)
+        if (vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create synchronization objects for a frame.");
+    cullFinishedSemaphores.assign(asyncCompute ? framesInFlight : 0, VK_NULL_HANDLE);
+    for (VkSemaphore& semaphore : cullFinishedSemaphores)
+        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create synchronization objects for a frame.");
+
+    if (timelineSemaphoresEnabled)
+    {
+        // Starts at the number of the last submitted frame, every frame up to it counts as complete.
+        VkSemaphoreTypeCreateInfoKHR typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        typeInfo.initialValue = frameNumber;
+        VkSemaphoreCreateInfo timelineInfo = semaphoreInfo;
+        timelineInfo.pNext = &typeInfo;
+        if (vkCreateSemaphore(logicalDevice, &timelineInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timeline semaphore.");
+    }
+}
+void VK::destroySyncObjects()
+{
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], nullptr);
+    for (VkFence fence : inFlightFences)
+        vkDestroyFence(logicalDevice, fence, nullptr);
+    inFlightFences.clear();
+    for (VkSemaphore semaphore : cullFinishedSemaphores)
+        vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+    cullFinishedSemaphores.clear();
+    if (frameTimeline != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(logicalDevice, frameTimeline, nullptr);
+        frameTimeline = VK_NULL_HANDLE;
+    }
+}
+/*
+    Returns true once frame and every frame submitted before it have finished on the GPU, without blocking.
+    With fences: older frames than the ones in frameSlotNumbers are complete, their fence was
+    waited on before it was reused. Fences are created signaled, so unused slots count as complete.
+*/
+bool VK::isFrameComplete(uint64_t frame)
+{
+    if (frame <= completedFrameNumber)
+        return true;
+    // Not submitted yet, e.g. the first frame after an upload.
+    if (frame > frameNumber)
+        return false;
+
+    if (timelineSemaphoresEnabled)
+    {
+        uint64_t value = 0;
+        if (pfnGetSemaphoreCounterValue(logicalDevice, frameTimeline, &value) != VK_SUCCESS)
+            throw std::runtime_error("Failed to read timeline semaphore value.");
+        completedFrameNumber = std::max(completedFrameNumber, value);
+        return frame <= value;
+    }
+
+    for (uint32_t i = 0; i < framesInFlight; i++)
+    {
+        if (frameSlotNumbers[i] <= frame && vkGetFenceStatus(logicalDevice, inFlightFences[i]) != VK_SUCCESS)
+            return false;
+    }
+    completedFrameNumber = frame;
+    return true;
+}
+// Blocks until frame and every frame submitted before it have finished on the GPU.
+void VK::waitForFrame(uint64_t frame)
+{
+    if (frame <= completedFrameNumber)
+        return;
+
+    if (timelineSemaphoresEnabled)
+    {
+        VkSemaphoreWaitInfoKHR waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &frame;
+        if (pfnWaitSemaphores(logicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+            throw std::runtime_error("Failed to wait for timeline semaphore.");
+    }
+    else
+    {
+        for (uint32_t i = 0; i < framesInFlight; i++)
+        {
+            if (frameSlotNumbers[i] <= frame)
+                vkWaitForFences(logicalDevice, 1, &inFlightFences[i], VK_TRUE, UINT64_MAX);
+        }
+    }
+    completedFrameNumber = frame;
+}
+
+void VK::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkBuffer& buffer, Allocation& allocation, const std::vector<uint32_t>& queueFamilies)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    /*
+        Exclusive buffers belong to one queue family at a time and change owner with a barrier
+        on both queues. Concurrent buffers can be used by the listed families without that,
+        but may be slower to access on some GPUs.
+    */
+    std::set<uint32_t> uniqueFamilies(queueFamilies.begin(), queueFamilies.end());
+    std::vector<uint32_t> sharedFamilies(uniqueFamilies.begin(), uniqueFamilies.end());
+    if (sharedFamilies.size() > 1)
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+        bufferInfo.pQueueFamilyIndices = sharedFamilies.data();
+    }
+    if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create buffer.");
+
+    // Memory comes from a block of the allocator, not a vkAllocateMemory call per buffer.
+    allocation = allocator.allocateForBuffer(buffer, properties);
+}
+void VK::destroyBuffer(VkBuffer& buffer, Allocation& allocation)
+{
+    vkDestroyBuffer(logicalDevice, buffer, nullptr);
+    allocator.free(allocation);
+    buffer = VK_NULL_HANDLE;
+}
+void VK::createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+    VkBuffer& buffer, Allocation& allocation, bool sharedWithCompute)
+{
+    /*
+        Device local memory is the fastest memory for the GPU to read, but on discrete GPUs
+        it is usually not accessible from the CPU. The data goes through the staging buffer
+        and is copied on the GPU, the copy is submitted with the next flushUploads().
+    */
+    std::vector<uint32_t> queueFamilies;
+    if (sharedWithCompute && asyncCompute)
+        queueFamilies = { graphicsQueueFamily, computeQueueFamily, transferQueueFamily };
+    createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation, queueFamilies);
+    uploadBuffer(buffer, data, size, 0, queueFamilies.empty());
+}
+void VK::createStagingBuffer(VkDeviceSize size)
+{
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer, stagingBufferAllocation);
+
+    // Host visible memory is kept mapped by the allocator.
+    stagingBufferMapped = stagingBufferAllocation.mapped;
+    stagingBufferSize = size;
+    stagingBufferOffset = 0;
+
+    if ((dedicatedTransferQueue || asyncCompute) && uploadSemaphore == VK_NULL_HANDLE)
+    {
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &uploadSemaphore) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create upload semaphore.");
+    }
+}
+void VK::destroyStagingBuffer()
+{
+    if (stagingBuffer == VK_NULL_HANDLE)
+        return;
+
+    destroyBuffer(stagingBuffer, stagingBufferAllocation);
+    stagingBufferMapped = nullptr;
+    stagingBufferSize = 0;
+}
+void VK::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset,
+    bool transferOwnership)
+{
+    VkDeviceSize offset = (stagingBufferOffset + 15) & ~VkDeviceSize(15);
+
+    /*
+        Staging memory is never written twice, submitted copies may still be reading it.
+        If the data doesn't fit behind them, what has been batched so far is submitted and
+        the buffer is retired until the first frame after the copies has completed.
+    */
+    if (stagingBuffer != VK_NULL_HANDLE && offset + size > stagingBufferSize)
+    {
+        flushUploads();
+        destroyDeferred(VK_OBJECT_TYPE_BUFFER, (uint64_t)stagingBuffer, stagingBufferAllocation, frameNumber + 1);
+        stagingBuffer = VK_NULL_HANDLE;
+        stagingBufferMapped = nullptr;
+        stagingBufferSize = 0;
+    }
+
+    // Create a staging buffer large enough for this upload if there is none.
+    if (stagingBuffer == VK_NULL_HANDLE)
+    {
+        createStagingBuffer(size > DEFAULT_STAGING_BUFFER_SIZE ? size : DEFAULT_STAGING_BUFFER_SIZE);
+        offset = 0;
+    }
+
+    // Start recording a one-shot command buffer for this batch.
+    if (uploadCommandBuffer == VK_NULL_HANDLE)
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = transferCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &uploadCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate upload command buffer.");
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(uploadCommandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("Failed to begin recording upload command buffer.");
+    }
+
+    memcpy(static_cast<char*>(stagingBufferMapped) + offset, data, (size_t)size);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = offset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+    // Release half of the ownership transfer, recorded when the batch is flushed.
+    if (dedicatedTransferQueue && transferOwnership)
+    {
+        VkBufferMemoryBarrier release{};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = 0; // Ignored on the releasing queue.
+        release.srcQueueFamilyIndex = transferQueueFamily;
+        release.dstQueueFamilyIndex = graphicsQueueFamily;
+        release.buffer = dstBuffer;
+        release.offset = dstOffset;
+        release.size = size;
+        uploadOwnershipTransfers.push_back(release);
+    }
+
+    stagingBufferOffset = offset + size;
+}
+void VK::flushUploads()
+{
+    if (uploadCommandBuffer == VK_NULL_HANDLE)
+        return;
+
+    const VkAccessFlags readAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+        | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    if (!dedicatedTransferQueue)
+    {
+        // Make the copied data visible to every later read of vertex, index, uniform or storage data.
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = readAccess;
+        vkCmdPipelineBarrier(uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    else if (!uploadOwnershipTransfers.empty())
+    {
+        vkCmdPipelineBarrier(uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, static_cast<uint32_t>(uploadOwnershipTransfers.size()), uploadOwnershipTransfers.data(), 0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(uploadCommandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end upload command buffer.");
+
+    // All batched copies go to the GPU in a single submit.
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &uploadCommandBuffer;
+
+    /*
+        Nothing waits for the copies on the CPU. The first frame submitted after them waits
+        on the GPU instead, so once that frame has completed the copies have as well.
+        The command buffers and staging memory are released through destroyDeferred.
+        Later submits to the graphics queue run after copies on the graphics queue and their barrier.
+        Other queues wait on uploadSemaphore: the graphics queue for a dedicated transfer queue,
+        the compute queue for asyncCompute. If no submit has waited for the previous upload yet,
+        this one waits for it first, so a single pending signal covers every upload so far.
+    */
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (uploadSemaphore != VK_NULL_HANDLE)
+    {
+        if (uploadSemaphorePending)
+        {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &uploadSemaphore;
+            submitInfo.pWaitDstStageMask = &waitStage;
+        }
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &uploadSemaphore;
+    }
+    if (vkQueueSubmit(dedicatedTransferQueue ? transferQueue : graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit upload command buffer.");
+    uploadSemaphorePending = uploadSemaphore != VK_NULL_HANDLE;
+
+    if (dedicatedTransferQueue)
+    {
+        /*
+            The graphics queue acquires the released buffers with the same barriers, at the start
+            of the next frame's submit. Concurrent buffers only need the semaphore wait.
+        */
+        if (!uploadOwnershipTransfers.empty())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VkCommandBuffer acquireCommandBuffer;
+            if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &acquireCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate upload command buffer.");
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (vkBeginCommandBuffer(acquireCommandBuffer, &beginInfo) != VK_SUCCESS)
+                throw std::runtime_error("Failed to begin recording upload command buffer.");
+            for (VkBufferMemoryBarrier& acquire : uploadOwnershipTransfers)
+            {
+                acquire.srcAccessMask = 0; // Ignored on the acquiring queue.
+                acquire.dstAccessMask = readAccess;
+            }
+            vkCmdPipelineBarrier(acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                0, 0, nullptr, static_cast<uint32_t>(uploadOwnershipTransfers.size()), uploadOwnershipTransfers.data(), 0, nullptr);
+            if (vkEndCommandBuffer(acquireCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to end upload command buffer.");
+            uploadAcquireCommandBuffers.push_back(acquireCommandBuffer);
+        }
+    }
+
+    destroyDeferred(transferCommandPool, uploadCommandBuffer, frameNumber + 1);
+    uploadCommandBuffer = VK_NULL_HANDLE;
+    uploadOwnershipTransfers.clear();
+}
+void VK::loadMesh()
+{
+    /*
+        Merge duplicated vertices, then order the triangles for the post-transform cache
+        (a vertex shared by triangles drawn close together is only shaded once)
+        and the vertices in the order they are fetched.
+    */
+    Mesh mesh = Mesh::fromTriangleList(vertices);
+    meshCacheMissRatioBefore = Mesh::averageCacheMissRatio(mesh.indices);
+    mesh.optimizeVertexCache();
+    meshCacheMissRatioAfter = Mesh::averageCacheMissRatio(mesh.indices);
+    mesh.optimizeVertexFetch();
+
+    meshRadius = 0.0f;
+    for (const Vertex& vertex : mesh.vertices)
+        meshRadius = std::max(meshRadius, std::sqrt(vertex.pos.x * vertex.pos.x + vertex.pos.y * vertex.pos.y));
+
+    meshIndexData = mesh.getIndexData();
+    indexCount = static_cast<uint32_t>(mesh.indices.size());
+    indexType = mesh.getIndexType();
 
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+    /*
+        Quantize the vertices if the requested format is compact and precise enough for this mesh.
+        16-bit positions have a resolution of about 1/32767 of the mesh extent (Snorm16)
+        or 1/2048 of the coordinate's magnitude (Half), colors 1/255.
+    */
+    activeVertexFormat = VertexFormat::Float32;
+    vertexPushConstants = VertexPushConstants();
+    if (vertexFormat != VertexFormat::Float32)
+    {
+        QuantizedVertices quantized = mesh.quantize(vertexFormat);
+        if (quantized.maxPositionError <= maxQuantizationError)
+        {
+            activeVertexFormat = vertexFormat;
+            vertexPushConstants.positionScale = quantized.positionScale;
+            vertexPushConstants.positionOffset = quantized.positionOffset;
+            meshVertexData.assign(reinterpret_cast<const char*>(quantized.vertices.data()),
+                reinterpret_cast<const char*>(quantized.vertices.data() + quantized.vertices.size()));
+        }
+        else
+        {
+            std::cerr << "Mesh loses " << quantized.maxPositionError << " of position precision as "
+                << getVertexFormatName(vertexFormat) << ", keeping float32 vertices." << std::endl;
+        }
+    }
+    if (activeVertexFormat == VertexFormat::Float32)
+    {
+        meshVertexData.assign(reinterpret_cast<const char*>(mesh.vertices.data()),
+            reinterpret_cast<const char*>(mesh.vertices.data() + mesh.vertices.size()));
+    }
+}
+void VK::createVertexBuffer()
+{
+    createDeviceLocalBuffer(meshVertexData.data(), meshVertexData.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferAllocation);
+    createDeviceLocalBuffer(meshIndexData.data(), meshIndexData.size(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferAllocation);
+
+    // Uploaded, the CPU copy is no longer needed.
+    meshVertexData = std::vector<char>();
+    meshIndexData = std::vector<char>();
+}
+void VK::destroyVertexBuffer()
+{
+    destroyBuffer(vertexBuffer, vertexBufferAllocation);
+    destroyBuffer(indexBuffer, indexBufferAllocation);
+}
+void VK::setInstances(const std::vector<InstanceData>& instances)
+{
+    if (instances.empty())
+        throw std::runtime_error("At least one instance is required.");
+
+    // Frames in flight may still read the old instances.
+    if (instanceBuffer != VK_NULL_HANDLE)
+        destroyDeferred(VK_OBJECT_TYPE_BUFFER, (uint64_t)instanceBuffer, instanceBufferAllocation);
+    for (uint32_t i = 0; i < visibleInstanceBuffers.size(); i++)
+        destroyDeferred(VK_OBJECT_TYPE_BUFFER, (uint64_t)visibleInstanceBuffers[i], visibleInstanceBufferAllocations[i]);
+
+    VkDeviceSize size = sizeof(instances[0]) * instances.size();
+    createDeviceLocalBuffer(instances.data(), size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBuffer, instanceBufferAllocation, gpuCulling);
+    flushUploads();
+    instanceCount = static_cast<uint32_t>(instances.size());
+
+    // Written by the culling shader, large enough for every instance to be visible.
+    visibleInstanceBuffers.assign(gpuCulling ? framesInFlight : 0, VK_NULL_HANDLE);
+    visibleInstanceBufferAllocations.assign(visibleInstanceBuffers.size(), Allocation());
+    for (uint32_t i = 0; i < visibleInstanceBuffers.size(); i++)
+        createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visibleInstanceBuffers[i], visibleInstanceBufferAllocations[i],
+            { graphicsQueueFamily, computeQueueFamily });
+    instanceBufferVersion++;
+}
+void VK::destroyInstanceBuffer()
+{
+    if (instanceBuffer != VK_NULL_HANDLE)
+        destroyBuffer(instanceBuffer, instanceBufferAllocation);
+    for (uint32_t i = 0; i < visibleInstanceBuffers.size(); i++)
+        destroyBuffer(visibleInstanceBuffers[i], visibleInstanceBufferAllocations[i]);
+    visibleInstanceBuffers.clear();
+    visibleInstanceBufferAllocations.clear();
+    instanceCount = 0;
+}
+
+// Milliseconds elapsed since start.
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+/*
+    Submits the current frame's culling to the compute queue. It overwrites the frame's copy of the
+    draw command and visible instances, so it waits on frameTimeline for lastReadFrame, the frame that
+    drew from that copy before. Frames in between keep drawing from their own copies meanwhile.
+*/
+bool VK::submitCulling(uint64_t lastReadFrame)
+{
+    // Culling reads the instances, so it is the first to wait for pending uploads.
+    bool waitForUploads = uploadSemaphorePending;
+    uploadSemaphorePending = false;
+
+    VkSemaphore waitSemaphores[] = { frameTimeline, uploadSemaphore };
+    uint64_t waitValues[] = { lastReadFrame, 0 }; // Binary semaphores ignore their value.
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+    uint32_t waitCount = waitForUploads ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameCommands[currentFrame].computeCommandBuffer;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    submitInfo.pSignalSemaphores = &cullFinishedSemaphores[currentFrame];
+    if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit culling command buffer.");
+    return waitForUploads;
+}
+void VK::render()
+{
+    frameTimings = FrameTimings{};
+    gpuFrameStats.available = false;
+    auto frameStart = std::chrono::steady_clock::now();
+
+    waitForFrame(frameSlotNumbers[currentFrame]);
+    destroyDeferredObjects(false);
+
+    // The frame previously submitted in this frame slot has finished, collect its GPU measurements.
+    readQueryResults(static_cast<uint32_t>(currentFrame));
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+    // Acquiring an image from the swap chain.
+    uint32_t imageIndex;
+    if (headless)
+    {
+        // No presentation engine to hand out images, cycle through the offscreen images.
+        imageIndex = offscreenImageIndex;
+        offscreenImageIndex = (offscreenImageIndex + 1) % static_cast<uint32_t>(swapchainImages.size());
+    }
+    else
+    {
+        VkResult result = vkAcquireNextImageKHR(logicalDevice, swapchain, UINT64_MAX,
+            imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            recreateSwapchain();
+            return;
+        }
+        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            throw std::runtime_error("Failed to acquire swapchain image.");
+    }
+
+    // Check if a previous frame is still rendering to this image.
+    waitForFrame(imageFrameNumbers[imageIndex]);
+
+    if (lowLatency)
+    {
+        /*
+            Wait for the last submitted frame instead of the one that used this frame slot,
+            the GPU is idle once this returns. Acquiring may block as well, so this comes last.
+            Window events are polled again afterwards, so the frame is recorded with the input
+            from right before recording, not from before the waits.
+        */
+        waitForFrame(frameNumber);
+        if (!headless)
+            glfwPollEvents();
+    }
+
+    frameTimings.acquire = elapsedMs(frameStart);
+    auto recordStart = std::chrono::steady_clock::now();
+    frameInputTimes[currentFrame] = recordStart;
+
+    writeUniforms();
+    vertexStream.beginFrame(static_cast<uint32_t>(currentFrame));
+    recordCommandBuffer(imageIndex);
+    // The recording threads are done appending, one flush covers all of their geometry.
+    vertexStream.flush();
+    queryResultsPending[currentFrame] = timestampQueryPool != VK_NULL_HANDLE || statisticsQueryPool != VK_NULL_HANDLE;
+
+    frameTimings.record = elapsedMs(recordStart);
+    auto submitStart = std::chrono::steady_clock::now();
+
+    // Reset fence before using it.
+    if (!timelineSemaphoresEnabled)
+        vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
+    uint64_t lastSlotFrame = frameSlotNumbers[currentFrame];
+    frameSlotNumbers[currentFrame] = ++frameNumber;
+    // Mark the image as now being in use by this frame
+    imageFrameNumbers[imageIndex] = frameNumber;
+
+    // Submitting the command buffer.
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    // The compute queue has to signal cullFinishedSemaphores before the draws can wait on it.
+    bool cullingWaitedForUploads = asyncCompute && submitCulling(lastSlotFrame);
+
+    /*
+        Offscreen images are ready as soon as their previous frame's fence signaled, nothing to wait on.
+        With asyncCompute the draws also wait for the culling results, and for pending uploads
+        through them if the culling waited for those.
+        Otherwise the frame waits for uploads from the transfer queue itself.
+    */
+    VkSemaphore waitSemaphores[3];
+    VkPipelineStageFlags waitStages[3];
+    uint32_t waitCount = 0;
+    if (!headless)
+    {
+        waitSemaphores[waitCount] = imageAvailableSemaphores[currentFrame];
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    if (asyncCompute)
+    {
+        waitSemaphores[waitCount] = cullFinishedSemaphores[currentFrame];
+        waitStages[waitCount++] = cullingWaitedForUploads ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+            : VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    }
+    if (uploadSemaphorePending)
+    {
+        waitSemaphores[waitCount] = uploadSemaphore;
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        uploadSemaphorePending = false;
+    }
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+
+    // Ownership acquires of uploaded buffers run first, in the same submit that waits for the copies.
+    std::vector<VkCommandBuffer> commandBuffers = uploadAcquireCommandBuffers;
+    commandBuffers.push_back(frameCommands[currentFrame].commandBuffer);
+    submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    submitInfo.pCommandBuffers = commandBuffers.data();
+
+    /*
+        The timeline semaphore is signaled with the frame number next to the binary semaphore
+        that presentation waits on. (binary semaphores ignore their value)
+        Headless frames signal only the timeline semaphore, or nothing but the fence.
+    */
+    VkSemaphore signalSemaphores[] = { headless ? VK_NULL_HANDLE : renderFinishedSemaphores[imageIndex], frameTimeline };
+    uint64_t signalValues[] = { 0, frameNumber };
+    uint32_t firstSignal = headless ? 1 : 0;
+    submitInfo.signalSemaphoreCount = (timelineSemaphoresEnabled ? 2 : 1) - firstSignal;
+    submitInfo.pSignalSemaphores = signalSemaphores + firstSignal;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues + firstSignal;
+    if (timelineSemaphoresEnabled)
+        submitInfo.pNext = &timelineInfo;
+
+    VkFence fence = timelineSemaphoresEnabled ? VK_NULL_HANDLE : inFlightFences[currentFrame];
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS)
         throw std::runtime_error("Failed to submit command buffer.");
+    for (VkCommandBuffer commandBuffer : uploadAcquireCommandBuffers)
+        destroyDeferred(commandPool, commandBuffer);
+    uploadAcquireCommandBuffers.clear();
+
+    frameTimings.submit = elapsedMs(submitStart);
+
+    if (headless)
+    {
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        frameTimings.total = elapsedMs(frameStart);
+        return;
+    }
+
+    auto presentStart = std::chrono::steady_clock::now();
 
     // Presentation.
     VkPresentInfoKHR presentInfo{};
@@ -1200,7 +2907,10 @@ void VK::render()
 
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    frameTimings.present = elapsedMs(presentStart);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+        queueRetiredSwapchains(frameNumber + framesInFlight);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
     {
@@ -1210,65 +2920,324 @@ void VK::render()
     else if (result != VK_SUCCESS)
         throw std::runtime_error("failed to present swap chain image!");
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    frameTimings.total = elapsedMs(frameStart);
 }
 void VK::init(VkApplicationInfo appInfo)
 {
-    initWindow();
-    initVulkan(appInfo);
-    createSurface();
-    selectPhysicalDevice();
-    createLogicalDevice();
-    initSwapchain();
-    createSyncObjects();
+    /*
+        Startup runs as a task graph: steps that don't depend on each other run at the same time,
+        e.g. the window is created while the Vulkan instance loads the driver, and the graphics
+        pipeline compiles while the mesh is uploaded.
+        Vulkan objects created on different threads need no locking as long as no two threads use
+        the same externally synchronized object: only the geometry upload submits to the graphics
+        queue and uses the command pool, the pipeline cache is internally synchronized and the
+        allocator and pipeline layout cache lock themselves.
+    */
+    auto startTime = std::chrono::steady_clock::now();
+    TaskGraph startup;
+
+    if (framesInFlight < 1)
+        throw std::runtime_error("At least one frame must be in flight.");
+
+    // glfwInit must come first, the instance needs the extensions GLFW requires.
+    if (!headless)
+        glfwInit();
+
+    TaskGraph::TaskId window = 0;
+    if (!headless)
+        window = startup.add("window", initWindow, {}, true); // GLFW windows are created on the main thread.
+    TaskGraph::TaskId instance = startup.add("instance", [appInfo] { initVulkan(appInfo); });
+    TaskGraph::TaskId surface = instance;
+    if (!headless)
+        surface = startup.add("surface", createSurface, { window, instance });
+    TaskGraph::TaskId physicalDeviceTask = startup.add("physical_device", selectPhysicalDevice, { surface });
+    TaskGraph::TaskId device = startup.add("device", []
+    {
+        createLogicalDevice();
+        allocator.init(deviceCapabilities, logicalDevice);
+        pipelineLayoutCache.init(logicalDevice);
+    }, { physicalDeviceTask });
+
+    TaskGraph::TaskId mesh = startup.add("mesh", loadMesh); // CPU only, decides the vertex format.
+    TaskGraph::TaskId cache = startup.add("pipeline_cache", createPipelineCache, { device });
+    TaskGraph::TaskId layout = startup.add("pipeline_layout", createPipelineLayout, { device });
+    startup.add("geometry_upload", []
+    {
+        createCommandPool();
+        createVertexBuffer();
+        // A single untransformed white instance, until the application sets its own.
+        setInstances({ InstanceData{ glm::vec2(0.0f), glm::vec2(1.0f), 0xffffffff } });
+    }, { device, mesh });
+    if (gpuCulling)
+        startup.add("culling_pipeline", createCullingPipeline, { cache });
+    startup.add("uniform_ring", createUniformRing, { layout });
+    startup.add("vertex_stream", []
+    {
+        /*
+            Vertex attributes are read with up to 4 byte components, 16 keeps every allocation aligned for them.
+            The padding of the per thread particle allocations comes out of vertexStreamCapacity.
+        */
+        VkDeviceSize particleBytes = VkDeviceSize(sizeof(InstanceData)) * particleCount;
+        vertexStream.create(logicalDevice, allocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            vertexStreamCapacity + particleBytes, framesInFlight, 16);
+    }, { device });
+    startup.add("frame_commands", []
+    {
+        uint32_t threadCount = recordingThreadCount >= 0 ? recordingThreadCount : std::thread::hardware_concurrency();
+        recordingThreads.start(threadCount);
+        createFrameCommands();
+        createQueryPools();
+    }, { device });
+    // Sizes the swapchain with glfwGetFramebufferSize, which GLFW only allows on the main thread.
+    TaskGraph::TaskId swapchainTask = startup.add("swapchain_and_pipeline", initSwapchain, { cache, layout, mesh }, !headless);
+    startup.add("sync_objects", createSyncObjects, { swapchainTask });
+
+    // The main thread takes part, so at most hardware_concurrency threads run tasks.
+    uint32_t workerCount = 0;
+    if (parallelInit)
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    startup.run(workerCount);
+    // Submits to the graphics queue, which the tasks may be using until they are all done.
+    calibrateTimestamps();
+
+    startupTimings = startup.getTimings();
+    startupMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
 }
 void VK::cleanup()
 {
     waitIdle();
+    // Swapchains retired since the last present never got queued.
+    queueRetiredSwapchains(frameNumber);
+    destroyDeferredObjects(true);
     destroySyncObjects();
     cleanupSwapchain();
+    recordingThreads.stop();
+    destroyFrameCommands();
+    destroyQueryPools();
+    destroyGraphicsPipeline();
+    destroyRenderPass();
+    destroyCullingPipeline();
+    destroyUniformRing();
+    vertexStream.destroy();
+    pipelineLayoutCache.destroy();
+    graphicsShaders = GraphicsShaders();
+    destroyInstanceBuffer();
+    destroyVertexBuffer();
+    destroyStagingBuffer();
+    if (uploadSemaphore != VK_NULL_HANDLE)
+        vkDestroySemaphore(logicalDevice, uploadSemaphore, nullptr);
     destroyCommandPool();
+    destroyPipelineCache();
+    allocator.destroy();
     destroyLogicalDevice();
-    destroySurface();
+    if (!headless)
+        destroySurface();
     destroyVulkanInstance();
-    terminateWindow();
+    if (!headless)
+        terminateWindow();
 }
+/*
+    Only objects that depend on the swapchain images or their size are recreated
+    when the window is resized: the swapchain, image views and framebuffers.
+    The render pass and pipeline only depend on the image format, so they are kept unless it changes.
+    Command buffers are recorded every frame and pick up the new framebuffers.
+*/
 void VK::initSwapchain()
 {
-    createSwapchain();
-    retrieveSwapchainImages();
+    VkFormat previousFormat = swapchainImageFormat;
+
+    if (headless)
+    {
+        createOffscreenImages();
+    }
+    else
+    {
+        createSwapchain();
+        retrieveSwapchainImages();
+    }
     createImageViews();
-    createRenderPass();
-    createPipelineLayout();
-    createGraphicsPipeline();
+
+    if (renderPass == VK_NULL_HANDLE)
+    {
+        createRenderPass();
+        if (pipelineLayout == VK_NULL_HANDLE)
+            createPipelineLayout();
+        createGraphicsPipeline();
+    }
+    else if (swapchainImageFormat != previousFormat)
+    {
+        // e.g. the window moved to a monitor with a different format.
+        // Frames in flight may still use the old ones.
+        destroyDeferred(VK_OBJECT_TYPE_PIPELINE, (uint64_t)graphicsPipeline);
+        destroyDeferred(VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)renderPass);
+        createRenderPass();
+        createGraphicsPipeline();
+    }
+
     createFramebuffers();
-    if (commandPool == VK_NULL_HANDLE)
-        createCommandPool();
-    allocateCommandBuffers();
-    createVertexBuffer();
-    beginRenderPass();
 }
 void VK::cleanupSwapchain()
 {
-    destroyVertexBuffer();
     destroyFramebuffers();
-    freeCommandBuffers();
-    destroyGraphicsPipeline();
-    destroyPipelineLayout();
-    destroyRenderPass();
     destroyImageViews();
-    destroySwapchain();
+    if (headless)
+        destroyOffscreenImages();
+    else
+        destroySwapchain();
+}
+/*
+    Hands the objects of the current swapchain to the deferred destruction queue,
+    so recreation does not have to wait for the frames in flight.
+    The swapchain handle is kept in VK::swapchain to be passed as oldSwapchain.
+*/
+void VK::retireSwapchain()
+{
+    for (auto framebuffer : swapchainFramebuffers)
+        destroyDeferred(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)framebuffer);
+    for (auto imageView : swapchainImageViews)
+        destroyDeferred(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)imageView);
+    if (headless)
+    {
+        for (size_t i = 0; i < swapchainImages.size(); i++)
+            destroyDeferred(VK_OBJECT_TYPE_IMAGE, (uint64_t)swapchainImages[i], offscreenImageAllocations[i]);
+    }
+    else
+    {
+        // Queued for destruction once the new swapchain presents.
+        retiredSwapchains.push_back(swapchain);
+        retiredRenderFinishedSemaphores.insert(retiredRenderFinishedSemaphores.end(),
+            renderFinishedSemaphores.begin(), renderFinishedSemaphores.end());
+        renderFinishedSemaphores.clear();
+    }
+
+    swapchainImages.clear();
+    offscreenImageAllocations.clear();
+    swapchainImageViews.clear();
+    swapchainFramebuffers.clear();
+}
+/*
+    Called after the current swapchain presented, the retired ones are no longer presented to.
+    Their pending presents are not covered by any frame's completion, so this relies on the
+    presentation engine: once the new swapchain has presented and a further frames-in-flight
+    cycle (lastUsedFrame) has completed, acquiring images for those frames means the presents
+    queued before them, including the old swapchain's, have finished with their images and
+    semaphores. VK_EXT_swapchain_maintenance1 present fences would make this explicit.
+*/
+void VK::queueRetiredSwapchains(uint64_t lastUsedFrame)
+{
+    // Relies on the new swapchain's present plus a frames-in-flight cycle, not on present fences.
+    for (VkSwapchainKHR retired : retiredSwapchains)
+        destroyDeferred(VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)retired, Allocation(), lastUsedFrame);
+    for (VkSemaphore semaphore : retiredRenderFinishedSemaphores)
+        destroyDeferred(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)semaphore, Allocation(), lastUsedFrame);
+    retiredSwapchains.clear();
+    retiredRenderFinishedSemaphores.clear();
+}
+void VK::destroyDeferred(VkObjectType type, uint64_t handle, const Allocation& allocation, uint64_t lastUsedFrame)
+{
+    DeferredDestruction destruction;
+    destruction.frame = lastUsedFrame;
+    destruction.type = type;
+    destruction.handle = handle;
+    destruction.allocation = allocation;
+    queueDeferredDestruction(destruction);
+}
+void VK::destroyDeferred(VkCommandPool commandPool, VkCommandBuffer commandBuffer, uint64_t lastUsedFrame)
+{
+    DeferredDestruction destruction;
+    destruction.frame = lastUsedFrame;
+    destruction.type = VK_OBJECT_TYPE_COMMAND_BUFFER;
+    destruction.handle = (uint64_t)commandBuffer;
+    destruction.commandPool = commandPool;
+    queueDeferredDestruction(destruction);
+}
+void VK::queueDeferredDestruction(const DeferredDestruction& destruction)
+{
+    // Keep the queue ordered by frame, objects are almost always queued with the latest frame.
+    auto position = deferredDestructions.end();
+    while (position != deferredDestructions.begin() && std::prev(position)->frame > destruction.frame)
+        --position;
+    deferredDestructions.insert(position, destruction);
+}
+void destroyObject(VkDevice logicalDevice, DeferredDestruction& destruction)
+{
+    switch (destruction.type)
+    {
+    case VK_OBJECT_TYPE_BUFFER:
+        vkDestroyBuffer(logicalDevice, (VkBuffer)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_IMAGE:
+        vkDestroyImage(logicalDevice, (VkImage)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_IMAGE_VIEW:
+        vkDestroyImageView(logicalDevice, (VkImageView)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_FRAMEBUFFER:
+        vkDestroyFramebuffer(logicalDevice, (VkFramebuffer)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_PIPELINE:
+        vkDestroyPipeline(logicalDevice, (VkPipeline)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_RENDER_PASS:
+        vkDestroyRenderPass(logicalDevice, (VkRenderPass)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_QUERY_POOL:
+        vkDestroyQueryPool(logicalDevice, (VkQueryPool)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+        vkDestroyDescriptorPool(logicalDevice, (VkDescriptorPool)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_SEMAPHORE:
+        vkDestroySemaphore(logicalDevice, (VkSemaphore)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+        vkDestroySwapchainKHR(logicalDevice, (VkSwapchainKHR)destruction.handle, nullptr);
+        break;
+    case VK_OBJECT_TYPE_COMMAND_BUFFER:
+    {
+        VkCommandBuffer commandBuffer = (VkCommandBuffer)destruction.handle;
+        vkFreeCommandBuffers(logicalDevice, destruction.commandPool, 1, &commandBuffer);
+        break;
+    }
+    default:
+        throw std::runtime_error("Deferred destruction of unsupported object type.");
+    }
+}
+void VK::destroyDeferredObjects(bool waitForAll)
+{
+    while (!deferredDestructions.empty())
+    {
+        // Ordered by frame, so stop at the first object that may still be in use.
+        DeferredDestruction& destruction = deferredDestructions.front();
+        if (!waitForAll && !isFrameComplete(destruction.frame))
+            break;
+
+        destroyObject(logicalDevice, destruction);
+        if (destruction.allocation.memory != VK_NULL_HANDLE)
+            allocator.free(destruction.allocation);
+        deferredDestructions.pop_front();
+    }
 }
 void VK::recreateSwapchain()
 {
-    int width = 0, height = 0;
-    glfwGetFramebufferSize(window, &width, &height);
-    while (width == 0 || height == 0) {
+    if (!headless)
+    {
+        int width = 0, height = 0;
         glfwGetFramebufferSize(window, &width, &height);
-        glfwWaitEvents();
+        while (width == 0 || height == 0) {
+            glfwGetFramebufferSize(window, &width, &height);
+            glfwWaitEvents();
+        }
     }
 
-    waitIdle();
-    cleanupSwapchain();
+    /*
+        No vkDeviceWaitIdle: the old objects are retired and destroyed once the frames
+        that use them have completed, while the next frames already use the new swapchain.
+    */
+    retireSwapchain();
     initSwapchain();
+
+    // The new swapchain may have a different number of images, and the old ones are no longer acquired.
+    imageFrameNumbers.assign(swapchainImages.size(), 0);
 }
@@ -10,6 +10,17 @@
 #include <vector>
 #include <optional>
 #include <array>
+#include <deque>
+#include <string>
+#include <chrono>
+
+#include "device_capabilities.h"
+#include "memory_allocator.h"
+#include "pipeline_layout_cache.h"
+#include "ring_buffer.h"
+#include "thread_pool.h"
+#include "task_graph.h"
+#include "vertex_layout.h"
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -21,6 +32,9 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Optional families without graphics support, their queues run next to the graphics queue.
+    std::optional<uint32_t> transferFamily; // Transfer only, usually the copy engines of a discrete GPU.
+    std::optional<uint32_t> computeFamily; // Compute without graphics.
 
     bool isComplete()
     {
@@ -33,35 +47,86 @@ struct SwapchainSupportDetails
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> presentModes;
 };
+// CPU time spent in the stages of a single VK::render call. (milliseconds)
+struct FrameTimings
+{
+    double acquire = 0.0; // Waiting for the frame's fence and acquiring a swapchain image.
+    double record = 0.0; // Recording the frame's command buffers.
+    double submit = 0.0;
+    double present = 0.0;
+    double total = 0.0;
+};
+// GPU side measurements of a completed frame, read back from query pools.
+struct GpuFrameStats
+{
+    bool available = false; // Set when new results were read back during the last VK::render call.
+    double gpuTime = 0.0; // Time between the timestamps around the render pass. (milliseconds)
+    /*
+        From sampling the input of the frame (the start of recording) until the GPU finished rendering it,
+        read from the timestamp after the render pass. (milliseconds, 0 without timestamps)
+    */
+    double latency = 0.0;
+    uint64_t vertexInvocations = 0; // Only if pipeline statistics queries are supported.
+    uint64_t fragmentInvocations = 0;
+};
+/*
+    An object that may still be used by frames in flight, destroyed once they have completed.
+    Identified like in VkDebugUtilsObjectNameInfoEXT: object type and handle cast to uint64_t.
+*/
+struct DeferredDestruction
+{
+    uint64_t frame = 0; // Last frame that may use the object.
+    VkObjectType type = VK_OBJECT_TYPE_UNKNOWN;
+    uint64_t handle = 0;
+    Allocation allocation; // Memory of buffers and images, freed with them.
+    VkCommandPool commandPool = VK_NULL_HANDLE; // Pool of a command buffer.
+};
+/*
+    Command buffers of one frame in flight, recorded again every frame.
+    Command pools must not be used from several threads at once, so every
+    secondary command buffer (recorded by one worker thread) has its own pool.
+*/
+struct FrameCommands
+{
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // Primary, submitted to the graphics queue.
+    VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+    VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE; // Culling, submitted to the compute queue. (asyncCompute only)
+    std::vector<VkCommandPool> secondaryCommandPools;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+};
+// Per instance data, every instance draws the whole mesh moved, scaled and tinted.
+struct InstanceData {
+    glm::vec2 offset;
+    glm::vec2 scale;
+    uint32_t color; // RGBA with 8 bits per channel, red in the lowest byte. (VK_FORMAT_R8G8B8A8_UNORM)
+};
+// Layout of the vertex data uploaded to the GPU.
+enum class VertexFormat {
+    Float32, // Vertex: 32-bit float position and color. (20 bytes)
+    Half, // CompactVertex: 16-bit float position, 8-bit color. (8 bytes)
+    Snorm16, // CompactVertex: 16-bit normalized position within the mesh bounds, 8-bit color. (8 bytes)
+};
+const char* getVertexFormatName(VertexFormat format);
+const char* getPresentModeName(VkPresentModeKHR mode);
 struct Vertex {
     glm::vec2 pos;
     glm::vec3 color;
-
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescription;
-    }
-
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-        // One attribute description per attribute
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-        return attributeDescriptions;
-    }
 };
+VERTEX_ATTRIBUTES(Vertex,
+    VERTEX_ATTRIBUTE(Vertex, pos),
+    VERTEX_ATTRIBUTE(Vertex, color));
+// Unpacked to a vec4 in [0, 1] by the vertex input stage.
+VERTEX_ATTRIBUTES(InstanceData,
+    VERTEX_ATTRIBUTE(InstanceData, offset),
+    VERTEX_ATTRIBUTE(InstanceData, scale),
+    VERTEX_ATTRIBUTE_FORMAT(InstanceData, color, VK_FORMAT_R8G8B8A8_UNORM));
+
+/*
+    Binding 0 advances per vertex, binding 1 per instance (VK_VERTEX_INPUT_RATE_INSTANCE),
+    so a single draw call can draw the mesh instanceCount times.
+*/
+using VertexInputLayout = VertexLayout<PerVertex<Vertex>, PerInstance<InstanceData>>;
 
 #ifdef NDEBUG
 static const bool enableValidationLayers = false;
@@ -75,16 +140,57 @@ public:
     static GLFWwindow* window;
     static int width, height;
 
+    // Headless mode: no window, surface or swapchain. Frames are rendered into offscreen images instead.
+    static bool headless;
+    static const int OFFSCREEN_IMAGE_COUNT = 3;
+    static std::vector<Allocation> offscreenImageAllocations;
+    static uint32_t offscreenImageIndex;
+
     static VkInstance instance;
 
     static VkSurfaceKHR surface;
 
     static VkPhysicalDevice physicalDevice;
+    /*
+        Snapshot of physicalDevice and its queue families, filled once by selectPhysicalDevice()
+        and only read afterwards. Suitable devices are ranked by DeviceCapabilities::getScore(),
+        deviceOverride (or the VK_EXAMPLE_DEVICE environment variable) picks one by its index
+        in the device list or part of its name instead.
+    */
+    static DeviceCapabilities deviceCapabilities;
+    static QueueFamilyIndices queueFamilyIndices;
+    static std::string deviceOverride;
 
     static VkDevice logicalDevice;
+    static MemoryAllocator allocator;
+    static PipelineLayoutCache pipelineLayoutCache; // Owns pipelineLayout, cullPipelineLayout and their set layouts.
     static VkQueue graphicsQueue;
     static VkQueue presentQueue;
 
+    /*
+        Dedicated queues, used if the device has queue families for them and useDedicatedQueues is set:
+        - Uploads are copied on the transfer queue. Buffers owned by the graphics queue family are
+          released by the transfer queue and acquired by the graphics queue (queue family ownership
+          transfer). The next frame waits for the copies on uploadSemaphore and runs the acquires first.
+        - GPU culling runs on the compute queue (asyncCompute). Every frame in flight culls into its own
+          buffers, so the submit only waits on frameTimeline for the frame that last drew from them and
+          overlaps the draws of the previous frame. It signals cullFinishedSemaphores, which the frame's draws wait on.
+          Buffers both queues access are shared with VK_SHARING_MODE_CONCURRENT instead of changing
+          owner twice per frame. Needs timeline semaphores.
+        Without them, the transfer and compute queues are the graphics queue.
+    */
+    static bool useDedicatedQueues;
+    static uint32_t graphicsQueueFamily;
+    static uint32_t transferQueueFamily;
+    static uint32_t computeQueueFamily;
+    static VkQueue transferQueue;
+    static VkQueue computeQueue;
+    static bool dedicatedTransferQueue;
+    static bool asyncCompute;
+    static VkCommandPool transferCommandPool; // The graphics commandPool without a dedicated transfer queue.
+    static VkSemaphore uploadSemaphore;
+    static std::vector<VkSemaphore> cullFinishedSemaphores; // Per frame in flight.
+
     static VkSwapchainKHR swapchain;
     static std::vector<VkImage> swapchainImages;
     static std::vector<VkImageView> swapchainImageViews;
@@ -92,23 +198,171 @@ public:
     static VkExtent2D swapchainExtent;
 
     static VkRenderPass renderPass;
+    static VkPipelineCache pipelineCache;
     static VkPipelineLayout pipelineLayout;
     static VkPipeline graphicsPipeline;
 
     static std::vector<VkFramebuffer> swapchainFramebuffers;
 
     static VkCommandPool commandPool;
-    static std::vector<VkCommandBuffer> commandBuffers;
+    static std::vector<FrameCommands> frameCommands; // Per frame in flight.
+
+    /*
+        The draws of a frame are split into secondary command buffers recorded in parallel.
+        The scene is the quad drawn drawCallCount times, standing in for a scene with many objects.
+    */
+    static ThreadPool recordingThreads;
+    static int recordingThreadCount; // -1: one per hardware thread, 0: record on the main thread.
+    static uint32_t drawCallCount;
+    static uint32_t instanceCount; // Instances drawn by every draw call, see setInstances().
+
+    /*
+        Vertex data format. Compact formats cut the vertex buffer from 20 to 8 bytes per vertex,
+        a mesh keeps 32-bit floats if quantizing moves any position by more than maxQuantizationError.
+    */
+    static VertexFormat vertexFormat; // Requested format.
+    static VertexFormat activeVertexFormat; // Format of the current vertex buffer.
+    static float maxQuantizationError; // In the mesh's own units.
+    // Mesh::averageCacheMissRatio of the mesh's indices before and after optimizeVertexCache().
+    static double meshCacheMissRatioBefore;
+    static double meshCacheMissRatioAfter;
+
+    // init() runs independent startup steps in parallel, see init().
+    static bool parallelInit;
+    static std::vector<TaskTiming> startupTimings; // Every startup step, in the order they were added.
+    static double startupMilliseconds; // Duration of init().
+
+    static std::string shaderDirectory; // Load .spv files from here instead of the embedded shaders, if present.
+
+    /*
+        GPU culling: before the render pass a compute shader tests the bounding circle of every
+        instance against the visible area, appends the visible ones to a second instance buffer
+        and counts them in the instanceCount of a VkDrawIndexedIndirectCommand.
+        The draws read that command with vkCmdDrawIndexedIndirect, so the CPU never touches instances.
+    */
+    static bool gpuCulling;
+    static glm::vec4 cullingFrustum; // Visible area: min x, min y, max x, max y. (normalized device coordinates, mapped into instance space for the shader)
+    static VkDescriptorSetLayout cullDescriptorSetLayout;
+    static VkPipelineLayout cullPipelineLayout;
+    static VkPipeline cullPipeline;
+    static VkDescriptorPool cullDescriptorPool;
+    static std::vector<VkDescriptorSet> cullDescriptorSets; // Per frame in flight.
+    static std::vector<uint64_t> cullDescriptorSetVersions; // Instance buffer version each set points at.
+
+    /*
+        Transforms: viewProjection applies to every draw call, drawTransforms[i] to draw call i.
+        (identity where the vector is shorter) Every frame they are written into the frame's part
+        of uniformRing, the vertex shader reads them through a single descriptor set of dynamic
+        uniform buffers. Each draw binds it with its own offsets, the set is never updated.
+        The ring is sized for drawCallCount. If the count changes, the next frame retires the ring
+        with destroyDeferred and creates a new one before recording.
+        A last identity slot after the draw calls serves geometry that is not transformed.
+        GPU culling tests the instances before these transforms, against cullingFrustum mapped
+        back through them.
+    */
+    static glm::mat4 viewProjection;
+    static std::vector<glm::mat4> drawTransforms;
+    static RingBuffer uniformRing;
+    static VkDescriptorSetLayout uniformDescriptorSetLayout;
+    static VkDescriptorPool uniformDescriptorPool;
+    static VkDescriptorSet uniformDescriptorSet;
+
+    /*
+        Streaming vertex data: geometry generated on the CPU every frame, such as debug lines,
+        UI and particles, is appended to the frame's part of vertexStream from any thread and
+        drawn straight from the mapped memory, without a staging copy. The memory is only
+        required to be host visible, if it is not coherent everything appended during the frame
+        is flushed at once before submitting. As an example the recording threads generate
+        particleCount particles every frame and draw them as instances of the mesh.
+    */
+    static RingBuffer vertexStream;
+    static VkDeviceSize vertexStreamCapacity; // Bytes per frame in flight, on top of the particles.
+    static uint32_t particleCount;
+    static const uint32_t MIN_PARTICLES_PER_SECONDARY = 16384;
+    static const uint32_t MIN_DRAWS_PER_SECONDARY = 256; // Below this, splitting costs more than it saves.
+
+    /*
+        Frame pacing, configured before init().
+        More frames in flight and swapchain images let the CPU run further ahead of the GPU
+        and the display (throughput), fewer keep the time from input to photons short (latency).
+        - presentMode: IMMEDIATE (no vsync, may tear), MAILBOX (no tearing, newest frame wins),
+                       FIFO (vsync, always supported), FIFO_RELAXED (vsync, tears when late).
+                       Falls back to FIFO if the surface doesn't support it.
+        - lowLatency: every frame waits for the GPU to finish the previous one once it has an image,
+                      then polls input and records right away, so the CPU never queues frames ahead.
+    */
+    static VkPresentModeKHR requestedPresentMode;
+    static VkPresentModeKHR presentMode; // Mode of the current swapchain.
+    static uint32_t requestedSwapchainImageCount; // 0: one more than the surface's minimum.
+    static uint32_t framesInFlight;
+    static bool lowLatency;
+    // When the input of the frame last recorded in each frame slot was sampled, for GpuFrameStats::latency.
+    static std::vector<std::chrono::steady_clock::time_point> frameInputTimes;
 
-    static const int MAX_FRAMES_IN_FLIGHT = 2;
     static std::vector<VkSemaphore> imageAvailableSemaphores;
-    static std::vector<VkSemaphore> renderFinishedSemaphores;
-    static std::vector<VkFence> inFlightFences;
-    static std::vector<VkFence> imagesInFlight;
+    static std::vector<VkSemaphore> renderFinishedSemaphores; // Per swapchain image, waited on by its present.
+    static std::vector<VkFence> inFlightFences; // Only used without timeline semaphores.
     static size_t currentFrame;
 
+    /*
+        Frames are numbered from 1 in submission order. frameSlotNumbers holds the number of
+        the frame last submitted in each frame slot (currentFrame), imageFrameNumbers the frame
+        last rendered to each swapchain image. (0: none)
+    */
+    static uint64_t frameNumber; // Number of the last submitted frame, 0 before the first one.
+    static std::vector<uint64_t> frameSlotNumbers;
+    static std::vector<uint64_t> imageFrameNumbers;
+
+    /*
+        How the CPU learns that frames have completed, chosen at init:
+        - Timeline semaphore (VK_KHR_timeline_semaphore, core in Vulkan 1.2): every submit signals
+          frameTimeline with its frame number, "has frame N completed" is a comparison with the
+          semaphore's counter and waiting for frame N is a wait for the counter to reach N.
+        - Fences: one of the inFlightFences per frame slot, frame N has completed once the fences
+          of all slots with a frame number up to N have signaled.
+        useTimelineSemaphores requests the first, devices without support fall back to fences.
+        Presentation always uses binary semaphores, the swapchain doesn't accept timeline semaphores.
+    */
+    static bool useTimelineSemaphores;
+    static bool timelineSemaphoresEnabled;
+    static VkSemaphore frameTimeline;
+    static uint64_t completedFrameNumber; // Highest frame known to have completed.
+    static std::deque<DeferredDestruction> deferredDestructions; // Ordered by frame.
+
     static bool framebufferResized;
 
+    /*
+        Staging uploads: data is written into a host visible staging buffer and copied
+        into device local buffers. Copies are batched until flushUploads() submits them at once.
+        The CPU never waits for them: the first frame submitted afterwards does, on the GPU.
+        A full staging buffer is retired with destroyDeferred until that frame has completed.
+    */
+    static const VkDeviceSize DEFAULT_STAGING_BUFFER_SIZE = 4 * 1024 * 1024;
+    static VkBuffer stagingBuffer;
+    static Allocation stagingBufferAllocation;
+    static void* stagingBufferMapped;
+    static VkDeviceSize stagingBufferSize;
+    static VkDeviceSize stagingBufferOffset;
+    static VkCommandBuffer uploadCommandBuffer;
+    static bool uploadSemaphorePending; // Signaled by flushed copies that no submit has waited for yet.
+    static std::vector<VkCommandBuffer> uploadAcquireCommandBuffers; // Submitted ahead of the next frame.
+    static std::vector<VkBufferMemoryBarrier> uploadOwnershipTransfers; // Released with the next flush.
+
+    static FrameTimings frameTimings; // Timings of the last rendered frame.
+
+    // Queries recorded around the render pass of every command buffer.
+    static bool timestampsSupported;
+    static bool pipelineStatisticsSupported;
+    static float timestampPeriod; // Nanoseconds per timestamp tick.
+    static uint64_t timestampMask;
+    // A GPU timestamp and the CPU time it was written at, to convert between the two clocks.
+    static uint64_t timestampCalibrationTicks;
+    static std::chrono::steady_clock::time_point timestampCalibrationTime;
+    static VkQueryPool timestampQueryPool; // Two timestamps per frame in flight.
+    static VkQueryPool statisticsQueryPool; // One pipeline statistics query per frame in flight.
+    static std::vector<bool> queryResultsPending; // Per frame in flight: submitted but not read back yet.
+    static GpuFrameStats gpuFrameStats;
+
     static void initWindow();
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
     static void terminateWindow();
@@ -116,7 +370,7 @@ public:
     static void destroyVulkanInstance();
     static void createSurface();
     static void destroySurface();
-    static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+    static QueueFamilyIndices findQueueFamilies(const DeviceCapabilities& device);
     static void selectPhysicalDevice();
     static void waitIdle();
     static void createLogicalDevice();
@@ -124,33 +378,84 @@ public:
     static bool checkValidationLayerSupport();
     static void createSwapchain();
     static void destroySwapchain();
+    static void createOffscreenImages();
+    static void destroyOffscreenImages();
     static void retrieveSwapchainImages();
     static void createImageViews();
     static void destroyImageViews();
     static void createRenderPass();
     static void destroyRenderPass();
+    static void createPipelineCache();
+    static void destroyPipelineCache();
     static void createPipelineLayout();
-    static void destroyPipelineLayout();
     static void createGraphicsPipeline();
     static void destroyGraphicsPipeline();
     static void createFramebuffers();
-    static void freeCommandBuffers();
     static void destroyFramebuffers();
     static void createCommandPool();
     static void destroyCommandPool();
-    static void allocateCommandBuffers();
-    static void beginRenderPass();
+    static void createFrameCommands();
+    static void destroyFrameCommands();
+    static void recordCommandBuffer(uint32_t imageIndex);
+    static void recordDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t firstDraw, uint32_t drawCount,
+        uint32_t firstParticle, uint32_t particleDrawCount);
+    static void recordParticles(VkCommandBuffer commandBuffer, uint32_t firstParticle, uint32_t count);
+    static void createQueryPools();
+    static void destroyQueryPools();
+    static void calibrateTimestamps();
+    static void readQueryResults(uint32_t frame);
+    static void createCullingPipeline();
+    static void destroyCullingPipeline();
+    static void recordCulling(VkCommandBuffer commandBuffer);
+    static bool submitCulling(uint64_t lastReadFrame); // Returns true if it also waited for pending uploads.
+    static void createUniformRing();
+    static void destroyUniformRing();
+    static void writeUniforms();
     static void createSyncObjects();
     static void destroySyncObjects();
+    static bool isFrameComplete(uint64_t frame);
+    static void waitForFrame(uint64_t frame);
 
+    // Buffers used by several queue families are created with VK_SHARING_MODE_CONCURRENT.
+    static void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        VkBuffer& buffer, Allocation& allocation, const std::vector<uint32_t>& queueFamilies = {});
+    static void destroyBuffer(VkBuffer& buffer, Allocation& allocation);
+    // sharedWithCompute: the compute queue reads the buffer as well. (asyncCompute)
+    static void createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+        VkBuffer& buffer, Allocation& allocation, bool sharedWithCompute = false);
+    static void createStagingBuffer(VkDeviceSize size);
+    static void destroyStagingBuffer();
+    // transferOwnership: hand the buffer from the transfer to the graphics queue family, false for concurrent buffers.
+    static void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0,
+        bool transferOwnership = true);
+    static void flushUploads();
+
+    static void loadMesh(); // Builds and encodes the mesh on the CPU, before createVertexBuffer() uploads it.
     static void createVertexBuffer();
     static void destroyVertexBuffer();
+    // Replaces the instances drawn every frame. The old buffer is destroyed once no frame in flight uses it.
+    static void setInstances(const std::vector<InstanceData>& instances);
+    static void destroyInstanceBuffer();
 
     static void init(VkApplicationInfo appInfo);
     static void cleanup();
     static void initSwapchain();
     static void cleanupSwapchain();
     static void recreateSwapchain();
+    static void retireSwapchain();
+    static void queueRetiredSwapchains(uint64_t lastUsedFrame);
+
+    /*
+        Destroy an object once the frames submitted so far (or up to lastUsedFrame) have completed,
+        instead of waiting for the device to idle. Supported types: buffer, image, image view,
+        framebuffer, pipeline, render pass, query pool, descriptor pool, semaphore and swapchain. Command buffers are freed
+        back to the pool they came from.
+    */
+    static void destroyDeferred(VkObjectType type, uint64_t handle, const Allocation& allocation = Allocation(),
+        uint64_t lastUsedFrame = frameNumber);
+    static void destroyDeferred(VkCommandPool commandPool, VkCommandBuffer commandBuffer, uint64_t lastUsedFrame = frameNumber);
+    static void queueDeferredDestruction(const DeferredDestruction& destruction);
+    static void destroyDeferredObjects(bool waitForAll);
     static void render();
 
 };